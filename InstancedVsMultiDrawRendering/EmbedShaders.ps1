@@ -0,0 +1,105 @@
+# Generates a header with the sources of all shaders so the executable doesn't depend on the working directory.
+# Additionally embeds SPIR-V of the permutations below if glslangValidator (part of the Vulkan SDK) is available.
+# The header is only rewritten when its content changes, so unchanged shaders don't trigger a recompile.
+param(
+    [Parameter(Mandatory = $true)][string]$ShaderDirectory,
+    [Parameter(Mandatory = $true)][string]$OutputFile
+)
+
+# defines of every precompiled SPIR-V permutation, looked up at runtime by FindEmbeddedSpirv
+$spirvPermutations = @(
+    ,@("SPECIALIZED")
+)
+$spirvStages = @{ "vertex.glsl" = "vert"; "fragment.glsl" = "frag" }
+
+$glslangValidator = (Get-Command glslangValidator -ErrorAction SilentlyContinue).Source
+if (!$glslangValidator -and $env:VULKAN_SDK)
+{
+    $glslangValidator = Join-Path $env:VULKAN_SDK "Bin\glslangValidator.exe"
+}
+if ($glslangValidator -and !(Test-Path $glslangValidator))
+{
+    $glslangValidator = $null
+}
+if (!$glslangValidator)
+{
+    Write-Warning "glslangValidator not found, SPIR-V shaders won't be embedded."
+}
+
+$lines = @(
+    "// Generated by EmbedShaders.ps1 from $((Split-Path -Leaf $ShaderDirectory)). Do not edit.",
+    "#pragma once",
+    "",
+    "#include <array>",
+    "#include <span>",
+    "#include <string_view>",
+    "#include <cstdint>",
+    "",
+    "struct EmbeddedShader",
+    "{",
+    "    std::string_view Name;",
+    "    std::string_view Source;",
+    "};",
+    "",
+    "struct EmbeddedSpirv",
+    "{",
+    "    std::string_view Name;",
+    "    std::string_view Defines;",
+    "    std::span<const uint32_t> Words;",
+    "};",
+    "",
+    "static constexpr EmbeddedShader EMBEDDED_SHADERS[] =",
+    "{"
+)
+
+$shaderFiles = Get-ChildItem -Path $ShaderDirectory -Filter *.glsl | Sort-Object Name
+foreach ($file in $shaderFiles)
+{
+    $source = [System.IO.File]::ReadAllText($file.FullName)
+    $lines += "    { `"$($file.Name)`", R`"glsl($source)glsl`" },"
+}
+$lines += "};"
+$lines += ""
+
+$spirvEntries = @()
+if ($glslangValidator)
+{
+    $spirvFile = [System.IO.Path]::GetTempFileName()
+    foreach ($file in $shaderFiles)
+    {
+        if (!$spirvStages.ContainsKey($file.Name))
+        {
+            continue
+        }
+
+        foreach ($defines in $spirvPermutations)
+        {
+            $defineArguments = $defines | ForEach-Object { "-D$_" }
+            & $glslangValidator -G -S $spirvStages[$file.Name] @defineArguments -o $spirvFile $file.FullName | Out-Null
+            if ($LASTEXITCODE -ne 0)
+            {
+                Write-Warning "Compiling $($file.Name) with $($defines -join ' ') to SPIR-V failed."
+                continue
+            }
+
+            $bytes = [System.IO.File]::ReadAllBytes($spirvFile)
+            $words = for ($i = 0; $i -lt $bytes.Length; $i += 4) { "0x{0:x8}" -f [System.BitConverter]::ToUInt32($bytes, $i) }
+
+            $arrayName = "SPIRV_$($spirvEntries.Count)"
+            $lines += "static constexpr uint32_t $arrayName[] = { $($words -join ', ') };"
+            $spirvEntries += "    EmbeddedSpirv{ `"$($file.Name)`", `"$($defines -join ' ')`", $arrayName },"
+        }
+    }
+    Remove-Item $spirvFile
+}
+
+$lines += "static constexpr std::array<EmbeddedSpirv, $($spirvEntries.Count)> EMBEDDED_SPIRV ="
+$lines += "{"
+$lines += $spirvEntries
+$lines += "};"
+$content = ($lines -join "`n") + "`n"
+
+if (!(Test-Path $OutputFile) -or [System.IO.File]::ReadAllText($OutputFile) -ne $content)
+{
+    [System.IO.File]::WriteAllText($OutputFile, $content, (New-Object System.Text.UTF8Encoding $false))
+}
@@ -1,6 +1,8 @@
 #version 460 core
+#ifdef COLLECT_SHADER_INFO
 #extension GL_KHR_shader_subgroup_basic : require
 #extension GL_KHR_shader_subgroup_ballot : require
+#endif
 
 layout(location = 0) in vec3 Position;
 
@@ -17,6 +19,7 @@ const Vertex Vertices[] =
 };
 
 
+#ifdef COLLECT_SHADER_INFO
 struct ShaderInfo
 {
     uint SubgroupMaxActiveLanes;
@@ -29,6 +32,26 @@ layout(binding = 0, std430) restrict buffer ShaderInfoSSBO
 {
     ShaderInfo Data;
 } shaderInfoSSBO;
+#endif
+
+// per-draw transforms, xy = translation, z = scale
+#if defined(TRANSFORM_SOURCE_SSBO)
+layout(binding = 1, std430) restrict readonly buffer TransformSSBO
+{
+    vec4 Transforms[];
+} transformSSBO;
+#elif defined(TRANSFORM_SOURCE_UBO)
+// holds one chunk of the transforms, the index restarts at 0 with every chunk's draw
+layout(binding = 0, std140) uniform TransformUBO
+{
+    vec4 Transforms[TRANSFORM_UBO_SIZE];
+} transformUBO;
+#elif defined(TRANSFORM_SOURCE_TBO)
+layout(binding = 0) uniform samplerBuffer TransformTBO;
+#elif defined(TRANSFORM_SOURCE_ATTRIBUTE)
+// advanced once per instance, multi draws select it through BaseInstance
+layout(location = 1) in vec4 TransformAttribute;
+#endif
 
 layout(location = 0) out InOutVars
 {
@@ -36,13 +59,29 @@ layout(location = 0) out InOutVars
     int RecordedIndex;
 } outVars;
 
+#ifdef SPECIALIZED
+// SPIR-V only, lets the driver constant fold the index source and triangle scale
+layout(constant_id = 0) const bool UseDrawID = false;
+layout(constant_id = 1) const int Count = 1;
+#elif defined(TRIANGLE_COUNT)
+// compile time specialized strategies inject the triangle count and their index source
+const int Count = TRIANGLE_COUNT;
+#else
 layout(location = 0) uniform bool UseDrawID;
 layout(location = 1) uniform int Count;
+#endif
 
 void main()
 {    
+#if defined(INDEX_SOURCE_DRAW_ID)
+    const int indexInQuestion = gl_DrawID;
+#elif defined(INDEX_SOURCE_INSTANCE_ID)
+    const int indexInQuestion = gl_InstanceID;
+#else
     const int indexInQuestion = UseDrawID ? gl_DrawID : gl_InstanceID;
+#endif
 
+#ifdef COLLECT_SHADER_INFO
     // Collect data
     {
         uint activeLanes = subgroupBallotBitCount(subgroupBallot(true));
@@ -60,7 +99,21 @@ void main()
             shaderInfoSSBO.Data.IsSubgroupUniform = 0;
         }
     }
-
+#endif
+
+#if defined(TRANSFORM_SOURCE_SSBO) || defined(TRANSFORM_SOURCE_UBO) || defined(TRANSFORM_SOURCE_TBO) || defined(TRANSFORM_SOURCE_ATTRIBUTE)
+#if defined(TRANSFORM_SOURCE_SSBO)
+    const vec4 transform = transformSSBO.Transforms[indexInQuestion];
+#elif defined(TRANSFORM_SOURCE_UBO)
+    const vec4 transform = transformUBO.Transforms[indexInQuestion];
+#elif defined(TRANSFORM_SOURCE_TBO)
+    const vec4 transform = texelFetch(TransformTBO, indexInQuestion);
+#else
+    const vec4 transform = TransformAttribute;
+#endif
+    const float triScale = transform.z;
+    const vec2 translation = transform.xy;
+#else
     const float triScale = 1.0 / sqrt(Count);
 
     vec2 translation;
@@ -71,6 +124,7 @@ void main()
 
         translation = vec2(x, y);
     }
+#endif
 
     const vec3 bary = vec3(gl_VertexID % 3 == 0, gl_VertexID % 3 == 1, gl_VertexID % 3 == 2);
     outVars.Color = bary;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+// order in which the passes are drawn, so caches and clocks don't systematically favor the passes drawn first
+enum class PassOrder
+{
+    Fixed, // the order of the passes table every frame
+    ABBA, // every other frame in reverse order
+    Randomized, // shuffled every frame
+    Blocks, // a single pass per frame, each one for PASS_ORDER_BLOCK_FRAMES frames in a row
+};
+
+// command line options, see the readme for what each of them does
+struct Settings
+{
+    std::string TracePath;
+    std::string ResultsPath;
+    uint64_t FrameCount = 0;
+    bool UseProgramCache = true;
+    std::string ProgramCacheDirectory; // next to the executable if empty
+    std::string ShaderDirectory;
+    bool HotReloadShaders = false;
+    size_t DrawCount = 10'000; // prefer square numbers
+    bool AnimateTransforms = false;
+    size_t FramesInFlight = 4; // frames submitted before the CPU waits for the oldest one, 0 waits for every frame
+    PassOrder Order = PassOrder::Fixed;
+    uint32_t Seed = std::random_device{}(); // of the randomized pass order, recorded in the results to reproduce it
+    float TargetConfidenceIntervalPercent = 0.0f; // samples until every pass is this precise, 0 disables adaptive sampling
+    float MaxSeconds = 0.0f; // 0 runs without time limit
+    std::string BaselinePassName; // compares every pass against this one instead of against their own baseline
+    // compare mode, runs without a window and only compares two results
+    std::string CompareBaselinePath; // a results file or a directory of them
+    std::string CompareResultsPath;
+    float RegressionThresholdPercent = 5.0f;
+    bool LlvmpipeSweep = false; // runs the benchmark once per LP_NUM_THREADS instead of rendering itself
+    std::vector<size_t> SweepDrawCounts; // runs the benchmark once per draw count in parallel worker processes instead of rendering itself
+    size_t WorkerCount = 0; // 0 picks one per 4 hardware threads on software rasterizers and a single one otherwise
+    bool HiddenWindow = false;
+};
@@ -0,0 +1,139 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+TimingStatistics ComputeStatistics(std::vector<float> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    TimingStatistics statistics = {};
+    statistics.SampleCount = samples.size();
+    if (!samples.empty())
+    {
+        auto middle = samples.size() / 2;
+        statistics.Median = samples.size() % 2 == 0 ? (samples[middle - 1] + samples[middle]) / 2.0f : samples[middle];
+        statistics.Min = samples.front();
+        statistics.Max = samples.back();
+
+        // distribution free, the ranks around the median which enclose it with 95% probability by the normal approximation of the binomial distribution
+        const float n = static_cast<float>(samples.size());
+        const float rankOffset = 1.96f * std::sqrt(n) / 2.0f;
+        const auto lowRank = static_cast<int64_t>(std::floor(n / 2.0f - rankOffset));
+        const auto highRank = static_cast<int64_t>(std::ceil(n / 2.0f + rankOffset));
+        statistics.MedianLow = samples[std::clamp<int64_t>(lowRank - 1, 0, samples.size() - 1)];
+        statistics.MedianHigh = samples[std::clamp<int64_t>(highRank - 1, 0, samples.size() - 1)];
+    }
+
+    return statistics;
+}
+
+// width of the confidence interval relative to the median
+float GetConfidenceIntervalPercent(const TimingStatistics& statistics)
+{
+    return (statistics.MedianHigh - statistics.MedianLow) / statistics.Median * 100.0f;
+}
+
+// two sided p-value of the Mann-Whitney U test by its normal approximation with tie correction, doesn't assume the timings to be normally distributed
+double ComputeMannWhitneyPValue(std::span<const float> a, std::span<const float> b)
+{
+    struct RankedSample
+    {
+        float Value;
+        bool IsFromA;
+    };
+
+    std::vector<RankedSample> samples;
+    samples.reserve(a.size() + b.size());
+    for (float value : a)
+    {
+        samples.push_back({ value, true });
+    }
+    for (float value : b)
+    {
+        samples.push_back({ value, false });
+    }
+    std::sort(samples.begin(), samples.end(), [](const RankedSample& lhs, const RankedSample& rhs) { return lhs.Value < rhs.Value; });
+
+    // tied samples share the average of their ranks
+    double rankSumA = 0.0;
+    double tieCorrection = 0.0;
+    for (size_t begin = 0; begin < samples.size();)
+    {
+        size_t end = begin;
+        while (end < samples.size() && samples[end].Value == samples[begin].Value)
+        {
+            end++;
+        }
+
+        const double tieCount = static_cast<double>(end - begin);
+        const double averageRank = (begin + 1 + end) / 2.0;
+        for (size_t i = begin; i < end; i++)
+        {
+            rankSumA += samples[i].IsFromA ? averageRank : 0.0;
+        }
+        tieCorrection += tieCount * tieCount * tieCount - tieCount;
+
+        begin = end;
+    }
+
+    const double nA = static_cast<double>(a.size());
+    const double nB = static_cast<double>(b.size());
+    const double n = nA + nB;
+    const double u = rankSumA - nA * (nA + 1.0) / 2.0;
+    const double variance = nA * nB / 12.0 * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+    if (!(variance > 0.0))
+    {
+        return 1.0;
+    }
+
+    // with continuity correction
+    const double z = std::max(std::abs(u - nA * nB / 2.0) - 0.5, 0.0) / std::sqrt(variance);
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+float GetMedian(std::vector<float>& samples)
+{
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+    if (samples.size() % 2 == 1)
+    {
+        return *middle;
+    }
+    return (*middle + *std::max_element(samples.begin(), middle)) / 2.0f;
+}
+
+static constexpr size_t BOOTSTRAP_RESAMPLES = 1000;
+
+// 95% percentile bootstrap confidence interval of the speedup median(baseline) / median(pass)
+std::pair<float, float> ComputeSpeedupInterval(std::span<const float> pass, std::span<const float> baseline, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    auto resampleMedian = [&](std::span<const float> samples, std::vector<float>& resample)
+    {
+        std::uniform_int_distribution<size_t> index(0, samples.size() - 1);
+        for (auto& value : resample)
+        {
+            value = samples[index(random)];
+        }
+        return GetMedian(resample);
+    };
+
+    std::vector<float> passResample(pass.size());
+    std::vector<float> baselineResample(baseline.size());
+    std::vector<float> speedups(BOOTSTRAP_RESAMPLES);
+    for (auto& speedup : speedups)
+    {
+        speedup = resampleMedian(baseline, baselineResample) / resampleMedian(pass, passResample);
+    }
+    std::sort(speedups.begin(), speedups.end());
+
+    return { speedups[BOOTSTRAP_RESAMPLES * 25 / 1000], speedups[BOOTSTRAP_RESAMPLES * 975 / 1000 - 1] };
+}
+
+float RoundTo(float value, uint32_t decimalPlaces)
+{
+    auto multiplier = std::pow(10.0f, decimalPlaces);
+    return std::round(value * multiplier) / multiplier;
+}
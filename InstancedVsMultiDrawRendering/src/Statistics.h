@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+struct TimingStatistics
+{
+    float Median;
+    float Min;
+    float Max;
+    size_t SampleCount;
+    // 95% confidence interval of the median
+    float MedianLow;
+    float MedianHigh;
+};
+
+TimingStatistics ComputeStatistics(std::vector<float> samples);
+
+// below this the confidence interval is just the range of the samples
+inline constexpr size_t MIN_CONFIDENCE_INTERVAL_SAMPLES = 10;
+
+// width of the confidence interval relative to the median
+float GetConfidenceIntervalPercent(const TimingStatistics& statistics);
+
+// two sided p-value of the Mann-Whitney U test, doesn't assume the timings to be normally distributed
+double ComputeMannWhitneyPValue(std::span<const float> a, std::span<const float> b);
+
+// reorders the samples
+float GetMedian(std::vector<float>& samples);
+
+// 95% percentile bootstrap confidence interval of the speedup median(baseline) / median(pass)
+std::pair<float, float> ComputeSpeedupInterval(std::span<const float> pass, std::span<const float> baseline, uint32_t seed);
+
+// differences with a higher p-value are reported as not significant
+inline constexpr double SIGNIFICANCE_LEVEL = 0.05;
+
+float RoundTo(float value, uint32_t decimalPlaces);
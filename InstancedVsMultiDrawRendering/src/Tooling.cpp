@@ -0,0 +1,463 @@
+#include "Tooling.h"
+
+#include <iostream>
+#include <fstream>
+#include <format>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <span>
+#include <optional>
+#include <thread>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+
+#include "Statistics.h"
+
+// GPU time samples of results files by GL_RENDERER, pass and draw count
+using ResultSamples = std::map<std::tuple<std::string, std::string, std::string>, std::vector<float>>;
+
+static std::vector<std::string_view> SplitTabs(std::string_view line)
+{
+    std::vector<std::string_view> fields;
+    for (size_t begin = 0;;)
+    {
+        size_t end = line.find('\t', begin);
+        fields.push_back(line.substr(begin, end - begin));
+        if (end == std::string_view::npos)
+        {
+            return fields;
+        }
+        begin = end + 1;
+    }
+}
+
+// reads the sample records, their columns are looked up by the names in the "# sample" header
+static bool LoadResultSamples(const std::filesystem::path& path, ResultSamples& samples)
+{
+    std::ifstream file{ path };
+    if (!file)
+    {
+        std::cout << std::format("Failed to open results file \"{}\".\n", path.string());
+        return false;
+    }
+
+    std::string renderer;
+    std::vector<std::string> sampleColumns;
+    auto getColumn = [&](std::string_view name)
+    {
+        return std::find(sampleColumns.begin(), sampleColumns.end(), name) - sampleColumns.begin();
+    };
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::vector<std::string_view> fields = SplitTabs(line);
+        if (fields.size() >= 3 && fields[0] == "environment" && fields[1] == "GL_RENDERER")
+        {
+            renderer = fields[2];
+        }
+        else if (fields[0] == "# sample")
+        {
+            sampleColumns.assign(fields.begin(), fields.end());
+        }
+        else if (fields[0] == "sample")
+        {
+            const size_t passColumn = getColumn("pass");
+            const size_t drawCountColumn = getColumn("draw count");
+            const size_t gpuColumn = getColumn("GPU ms");
+            if (std::max({ passColumn, drawCountColumn, gpuColumn }) >= fields.size())
+            {
+                std::cout << std::format("Results file \"{}\" has samples without pass, draw count or GPU time.\n", path.string());
+                return false;
+            }
+
+            auto key = std::make_tuple(renderer, std::string(fields[passColumn]), std::string(fields[drawCountColumn]));
+            samples[key].push_back(std::stof(std::string(fields[gpuColumn])));
+        }
+    }
+
+    return true;
+}
+
+int CompareResults(const Settings& settings)
+{
+    ResultSamples baselineSamples;
+    if (std::filesystem::is_directory(settings.CompareBaselinePath))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(settings.CompareBaselinePath))
+        {
+            if (entry.path().extension() == ".tsv" && !LoadResultSamples(entry.path(), baselineSamples))
+            {
+                return 2;
+            }
+        }
+    }
+    else if (!LoadResultSamples(settings.CompareBaselinePath, baselineSamples))
+    {
+        return 2;
+    }
+
+    ResultSamples samples;
+    if (!LoadResultSamples(settings.CompareResultsPath, samples))
+    {
+        return 2;
+    }
+
+    size_t regressionCount = 0;
+    size_t comparedCount = 0;
+    for (auto& [key, msSamples] : samples)
+    {
+        const auto& [renderer, pass, drawCount] = key;
+        std::cout << std::format("{} / {} / {} draws\n", renderer, pass, drawCount);
+
+        auto baseline = baselineSamples.find(key);
+        if (baseline == baselineSamples.end())
+        {
+            std::cout << "* No baseline\n";
+            continue;
+        }
+        comparedCount++;
+
+        std::vector<float>& msBaseline = baseline->second;
+        const float msMedian = GetMedian(msSamples);
+        const float msBaselineMedian = GetMedian(msBaseline);
+        const float deltaPercent = (msMedian / msBaselineMedian - 1.0f) * 100.0f;
+        auto [speedupLow, speedupHigh] = ComputeSpeedupInterval(msSamples, msBaseline, 0);
+        const double pValue = ComputeMannWhitneyPValue(msSamples, msBaseline);
+
+        const bool isSignificant = pValue < SIGNIFICANCE_LEVEL;
+        const bool isRegression = isSignificant && deltaPercent > settings.RegressionThresholdPercent;
+        regressionCount += isRegression;
+
+        std::cout << std::format("* {}ms vs {}ms baseline: {:+.2f}% GPU time (speedup 95% CI {}x to {}x, p = {:.4f}){}\n",
+            RoundTo(msMedian, 3),
+            RoundTo(msBaselineMedian, 3),
+            deltaPercent,
+            RoundTo(speedupLow, 3),
+            RoundTo(speedupHigh, 3),
+            pValue,
+            isRegression ? " REGRESSION" : isSignificant ? "" : " not significant");
+    }
+
+    // a pass which disappeared from the results can't regress, so it has to be pointed out instead
+    for (const auto& [key, msBaseline] : baselineSamples)
+    {
+        if (!samples.contains(key))
+        {
+            const auto& [renderer, pass, drawCount] = key;
+            std::cout << std::format("{} / {} / {} draws\n* No new samples\n", renderer, pass, drawCount);
+        }
+    }
+
+    if (comparedCount == 0)
+    {
+        std::cout << "\nNo GL_RENDERER, pass and draw count is in both the baseline and the results, nothing was compared.\n";
+        return 3;
+    }
+
+    std::cout << std::format("\n{} of {} compared passes regressed above {}%.\n", regressionCount, comparedCount, settings.RegressionThresholdPercent);
+    return regressionCount > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// setenv doesn't exist on Windows, child processes inherit the variable
+void WriteEnvironmentVariable(const char* name, const std::string& value)
+{
+#ifdef _MSC_VER
+    _putenv_s(name, value.c_str());
+#else
+    setenv(name, value.c_str(), 1);
+#endif
+}
+
+// getenv is deprecated by MSVC
+std::optional<std::string> ReadEnvironmentVariable(const char* name)
+{
+#ifdef _MSC_VER
+    char* value = nullptr;
+    size_t size;
+    if (_dupenv_s(&value, &size, name) != 0 || value == nullptr)
+    {
+        return std::nullopt;
+    }
+    std::string result = value;
+    free(value);
+    return result;
+#else
+    const char* value = std::getenv(name);
+    if (value == nullptr)
+    {
+        return std::nullopt;
+    }
+    return value;
+#endif
+}
+
+// runs an executable with the given arguments and waits for it to exit, prefix is prepended to the shell command
+static int RunChildProcess(std::string_view executable, std::span<const std::string> arguments, std::string_view prefix = "")
+{
+    std::string command = std::format("{}\"{}\"", prefix, executable);
+    for (const auto& argument : arguments)
+    {
+        command += std::format(" \"{}\"", argument);
+    }
+#ifdef _WIN32
+    // cmd strips the outermost quotes
+    command = std::format("\"{}\"", command);
+#endif
+
+    std::cout.flush();
+    return std::system(command.c_str());
+}
+
+static constexpr auto LLVMPIPE_SWEEP_DIRECTORY = "llvmpipe_sweep";
+// frames of each run of a sweep unless the frame count or adaptive sampling is given
+static constexpr uint64_t SWEEP_DEFAULT_FRAMES = 200;
+
+// the passes whose scaling gets reported
+static constexpr std::array<std::string_view, 2> LLVMPIPE_SWEEP_PASSES = { "Uninstrumented gl_InstanceID", "Uninstrumented gl_DrawID" };
+
+int RunLlvmpipeSweep(const Settings& settings, int argc, char** argv)
+{
+    // powers of two up to and including all hardware threads, every count would take too long on many core hosts
+    std::vector<uint32_t> threadCounts;
+    const uint32_t maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+    {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreadCount);
+
+    std::vector<std::string> forwardedArguments;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--llvmpipe-sweep")
+        {
+            continue;
+        }
+        if (arg == "--results" || arg == "--trace" || arg == "--workers")
+        {
+            i++;
+            continue;
+        }
+        forwardedArguments.push_back(argv[i]);
+    }
+    if (settings.FrameCount == 0 && settings.TargetConfidenceIntervalPercent == 0.0f && settings.MaxSeconds == 0.0f)
+    {
+        forwardedArguments.push_back("--frames");
+        forwardedArguments.push_back(std::to_string(SWEEP_DEFAULT_FRAMES));
+    }
+
+    std::filesystem::create_directories(LLVMPIPE_SWEEP_DIRECTORY);
+    // GALLIUM_DRIVER only picks between the software rasterizers, without LIBGL_ALWAYS_SOFTWARE Mesa still loads the hardware driver
+    WriteEnvironmentVariable("LIBGL_ALWAYS_SOFTWARE", "1");
+    WriteEnvironmentVariable("GALLIUM_DRIVER", "llvmpipe");
+
+    // median GPU time of every swept pass by thread count, missing if a run has no samples of the pass (e.g. --order blocks with few frames)
+    std::vector<std::array<std::optional<float>, LLVMPIPE_SWEEP_PASSES.size()>> msMedians;
+    for (uint32_t threadCount : threadCounts)
+    {
+        auto resultsPath = std::filesystem::path(LLVMPIPE_SWEEP_DIRECTORY) / std::format("lp_num_threads_{}.tsv", threadCount);
+        std::cout << std::format("Running with LP_NUM_THREADS={}...\n", threadCount);
+
+        WriteEnvironmentVariable("LP_NUM_THREADS", std::to_string(threadCount));
+        std::vector<std::string> arguments = forwardedArguments;
+        arguments.push_back("--results");
+        arguments.push_back(resultsPath.string());
+        if (!settings.TracePath.empty())
+        {
+            // one trace per thread count, every run would overwrite the same file otherwise
+            std::filesystem::path tracePath = settings.TracePath;
+            tracePath.replace_filename(std::format("{}_lp_num_threads_{}{}", tracePath.stem().string(), threadCount, tracePath.extension().string()));
+            arguments.insert(arguments.end(), { "--trace", tracePath.string() });
+        }
+        if (RunChildProcess(argv[0], arguments) != 0)
+        {
+            std::cout << std::format("Run with LP_NUM_THREADS={} failed.\n", threadCount);
+            return EXIT_FAILURE;
+        }
+
+        ResultSamples samples;
+        if (!LoadResultSamples(resultsPath, samples))
+        {
+            return EXIT_FAILURE;
+        }
+
+        auto& medians = msMedians.emplace_back();
+        for (auto& [key, msSamples] : samples)
+        {
+            const auto& [renderer, pass, drawCount] = key;
+            if (renderer.find("llvmpipe") == std::string::npos)
+            {
+                std::cout << std::format("The benchmark ran on \"{}\" instead of llvmpipe, LP_NUM_THREADS has no effect.\n", renderer);
+                return EXIT_FAILURE;
+            }
+
+            auto sweptPass = std::find(LLVMPIPE_SWEEP_PASSES.begin(), LLVMPIPE_SWEEP_PASSES.end(), pass);
+            if (sweptPass != LLVMPIPE_SWEEP_PASSES.end())
+            {
+                medians[sweptPass - LLVMPIPE_SWEEP_PASSES.begin()] = GetMedian(msSamples);
+            }
+        }
+    }
+
+    // speedups are relative to a single thread
+    std::cout << std::format("\nllvmpipe thread scaling, median GPU time and speedup over 1 thread. Results are in {}\n", std::filesystem::absolute(LLVMPIPE_SWEEP_DIRECTORY).string());
+    std::cout << std::format("{:<16}{:>30}{:>30}{:>12}\n", "LP_NUM_THREADS", LLVMPIPE_SWEEP_PASSES[0], LLVMPIPE_SWEEP_PASSES[1], "DrawID cost");
+    for (size_t i = 0; i < threadCounts.size(); i++)
+    {
+        std::array<std::string, LLVMPIPE_SWEEP_PASSES.size()> cells;
+        for (size_t j = 0; j < cells.size(); j++)
+        {
+            const auto& msMedian = msMedians[i][j];
+            const auto& msSingleThreadMedian = msMedians[0][j];
+            cells[j] = !msMedian ? "n/a" : !msSingleThreadMedian ? std::format("{}ms", RoundTo(*msMedian, 3))
+                : std::format("{}ms ({}x)", RoundTo(*msMedian, 3), RoundTo(*msSingleThreadMedian / *msMedian, 2));
+        }
+        const bool hasBothPasses = msMedians[i][0] && msMedians[i][1];
+        const std::string drawIDCost = hasBothPasses ? std::format("{}x", RoundTo(*msMedians[i][1] / *msMedians[i][0], 2)) : "n/a";
+        std::cout << std::format("* {:.<12}: {:>30}{:>30}{:>12}\n", threadCounts[i], cells[0], cells[1], drawIDCost);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// software rasterizers render on the CPU, so parallel workers have to share the cores instead of a GPU
+// only LIBGL_ALWAYS_SOFTWARE switches Mesa to them, GALLIUM_DRIVER just picks which one and is ignored on hardware
+static bool IsSoftwareRasterizerRequested()
+{
+    auto alwaysSoftware = ReadEnvironmentVariable("LIBGL_ALWAYS_SOFTWARE");
+    if (!alwaysSoftware)
+    {
+        return false;
+    }
+
+    // parsed like Mesa parses booleans, anything but these means true
+    std::string value = *alwaysSoftware;
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return !(value.empty() || value == "0" || value == "false" || value == "n" || value == "no");
+}
+
+// pins a worker to its own contiguous range of cores and gives llvmpipe as many threads as it has cores
+static std::string GetPinnedWorkerCommandPrefix(uint32_t firstCore, uint32_t coreCount)
+{
+#ifdef _WIN32
+    const uint64_t mask = (coreCount >= 64 ? ~0ull : (1ull << coreCount) - 1) << firstCore;
+    return std::format("set LP_NUM_THREADS={}&& start \"\" /b /wait /affinity {:X} ", coreCount, mask);
+#else
+    return std::format("LP_NUM_THREADS={} taskset -c {}-{} ", coreCount, firstCore, firstCore + coreCount - 1);
+#endif
+}
+
+static constexpr auto SWEEP_DIRECTORY = "sweep";
+static constexpr auto SWEEP_DEFAULT_RESULTS_PATH = "sweep_results.tsv";
+
+int RunSweep(const Settings& settings, int argc, char** argv)
+{
+    const bool isSoftwareRasterizer = IsSoftwareRasterizerRequested();
+    const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t workerCount = settings.WorkerCount;
+    if (workerCount == 0)
+    {
+        // workers on the same GPU would distort each others timings
+        workerCount = isSoftwareRasterizer ? std::max(threadCount / 4u, 1u) : 1;
+    }
+    workerCount = std::min(workerCount, settings.SweepDrawCounts.size());
+    if (isSoftwareRasterizer)
+    {
+        workerCount = std::min<size_t>(workerCount, threadCount);
+    }
+    const uint32_t coresPerWorker = std::max(threadCount / static_cast<uint32_t>(workerCount), 1u);
+
+    std::vector<std::string> forwardedArguments;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--sweep" || arg == "--workers" || arg == "--results" || arg == "--draw-count" || arg == "--trace")
+        {
+            i++;
+            continue;
+        }
+        if (arg == "--hidden")
+        {
+            continue;
+        }
+        forwardedArguments.push_back(argv[i]);
+    }
+    forwardedArguments.push_back("--hidden");
+    if (settings.FrameCount == 0 && settings.TargetConfidenceIntervalPercent == 0.0f && settings.MaxSeconds == 0.0f)
+    {
+        forwardedArguments.push_back("--frames");
+        forwardedArguments.push_back(std::to_string(SWEEP_DEFAULT_FRAMES));
+    }
+
+    std::filesystem::create_directories(SWEEP_DIRECTORY);
+    std::vector<std::filesystem::path> resultsPaths;
+    for (size_t drawCount : settings.SweepDrawCounts)
+    {
+        resultsPaths.push_back(std::filesystem::path(SWEEP_DIRECTORY) / std::format("draw_count_{}.tsv", drawCount));
+    }
+
+    std::cout << std::format("Sweeping {} draw counts with {} workers{}.\n", settings.SweepDrawCounts.size(), workerCount,
+        isSoftwareRasterizer ? std::format(" pinned to {} cores each", coresPerWorker) : "");
+
+    // every worker takes the next configuration until none are left
+    std::atomic<size_t> nextConfiguration = 0;
+    std::atomic<bool> hasFailed = false;
+    {
+        std::vector<std::jthread> workers;
+        for (size_t worker = 0; worker < workerCount; worker++)
+        {
+            workers.emplace_back([&, worker]()
+            {
+                std::string prefix = isSoftwareRasterizer ? GetPinnedWorkerCommandPrefix(worker * coresPerWorker, coresPerWorker) : "";
+                for (size_t i = nextConfiguration++; i < settings.SweepDrawCounts.size(); i = nextConfiguration++)
+                {
+                    std::vector<std::string> arguments = forwardedArguments;
+                    arguments.insert(arguments.end(), { "--draw-count", std::to_string(settings.SweepDrawCounts[i]), "--results", resultsPaths[i].string() });
+                    if (!settings.TracePath.empty())
+                    {
+                        // one trace per draw count, concurrent workers would write into the same file otherwise
+                        std::filesystem::path tracePath = settings.TracePath;
+                        tracePath.replace_filename(std::format("{}_draw_count_{}{}", tracePath.stem().string(), settings.SweepDrawCounts[i], tracePath.extension().string()));
+                        arguments.insert(arguments.end(), { "--trace", tracePath.string() });
+                    }
+
+                    auto start = std::chrono::steady_clock::now();
+                    bool isSuccess = RunChildProcess(argv[0], arguments, prefix) == 0;
+                    if (!isSuccess)
+                    {
+                        hasFailed = true;
+                    }
+
+                    std::cout << std::format("Worker {}: draw count {} {} after {}s\n", worker, settings.SweepDrawCounts[i], isSuccess ? "finished" : "failed",
+                        RoundTo(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count(), 1));
+                }
+            });
+        }
+    }
+
+    if (hasFailed)
+    {
+        std::cout << "Some sweep runs failed, their results are not merged.\n";
+        return EXIT_FAILURE;
+    }
+
+    // results files are self describing, so the merged file is their concatenation and can be read like any of them
+    const std::string mergedPath = settings.ResultsPath.empty() ? SWEEP_DEFAULT_RESULTS_PATH : settings.ResultsPath;
+    std::ofstream merged{ mergedPath, std::ios::out | std::ios::trunc };
+    for (size_t i = 0; i < resultsPaths.size(); i++)
+    {
+        std::ifstream file{ resultsPaths[i] };
+        merged << std::format("# run\tdraw count\t{}\n", settings.SweepDrawCounts[i]);
+        merged << file.rdbuf();
+    }
+    std::cout << std::format("Merged the results of {} runs into {}.\n", resultsPaths.size(), std::filesystem::absolute(mergedPath).string());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <optional>
+
+#include "Settings.h"
+
+// compares the GPU time of every (GL_RENDERER, pass, draw count) against the baseline
+// returns EXIT_FAILURE if any got significantly slower than the threshold, 2 if a results file could not be read
+// and 3 if nothing could be compared, e.g. because the baseline is from another GPU or draw count
+int CompareResults(const Settings& settings);
+
+// environment of this process, child processes inherit what gets written
+void WriteEnvironmentVariable(const char* name, const std::string& value);
+std::optional<std::string> ReadEnvironmentVariable(const char* name);
+
+// runs the benchmark once per LP_NUM_THREADS with every other argument forwarded and reports how the timings scale
+int RunLlvmpipeSweep(const Settings& settings, int argc, char** argv);
+
+// shards the draw counts across worker processes, each with its own hidden window and context, and merges their results into one file
+int RunSweep(const Settings& settings, int argc, char** argv);
@@ -4,10 +4,40 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <span>
+#include <deque>
+#include <filesystem>
+#include <cstring>
+#include <thread>
+#include <optional>
+#include <random>
+#include <numeric>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// for reading the CPU model
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "EmbeddedShaders.h"
+#include "Settings.h"
+#include "Statistics.h"
+#include "Tooling.h"
+
 static void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
     if (type == 33361)
@@ -23,30 +53,451 @@ static void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GL
     std::cout << message << '\n';
 }
 
-static uint32_t MakeShader(GLenum type, const char* srcCode)
+static std::string LoadFile(std::string_view path)
+{
+    std::ifstream file{ path.data(), std::ios::in | std::ios::binary };
+    std::string fileData{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    return fileData;
+}
+
+static uint64_t HashFnv1a(std::string_view data, uint64_t hash = 14695981039346656037ull)
+{
+    for (auto c : data)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool IsExtensionSupported(std::string_view name)
+{
+    int extensionCount;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (int i = 0; i < extensionCount; i++)
+    {
+        if (name == reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// GL_KHR_parallel_shader_compile isn't part of the generated glad loader
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+static bool HasParallelShaderCompile = false;
+
+static void InitParallelShaderCompile()
+{
+    // the ARB extension is identical to the KHR one but exports a differently named function
+    const char* functionName = nullptr;
+    if (IsExtensionSupported("GL_KHR_parallel_shader_compile"))
+    {
+        functionName = "glMaxShaderCompilerThreadsKHR";
+    }
+    else if (IsExtensionSupported("GL_ARB_parallel_shader_compile"))
+    {
+        functionName = "glMaxShaderCompilerThreadsARB";
+    }
+
+    if (functionName != nullptr)
+    {
+        auto glMaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(glfwGetProcAddress(functionName));
+        if (glMaxShaderCompilerThreads != nullptr)
+        {
+            // let the implementation pick as many threads as it wants to
+            glMaxShaderCompilerThreads(0xFFFFFFFF);
+            HasParallelShaderCompile = true;
+        }
+    }
+}
+
+static uint32_t SubmitShader(GLenum type, std::string_view srcCode, std::span<const std::string> defines)
 {
+    // inject defines right after the #version directive, since it has to be the first statement in the source
+    std::string permutedSrc(srcCode);
+    {
+        auto versionEnd = permutedSrc.find('\n', permutedSrc.find("#version")) + 1;
+
+        std::string defineLines;
+        for (const auto& define : defines)
+        {
+            defineLines += std::format("#define {}\n", define);
+        }
+        permutedSrc.insert(versionEnd, defineLines);
+    }
+
     auto shader = glCreateShader(type);
-    glShaderSource(shader, 1, &srcCode, 0);
+    const char* permutedSrcPtr = permutedSrc.data();
+    glShaderSource(shader, 1, &permutedSrcPtr, 0);
     glCompileShader(shader);
 
+    return shader;
+}
+
+static void PrintShaderInfoLog(uint32_t shader)
+{
     std::string infoLog(4096, '\0');
     glGetShaderInfoLog(shader, infoLog.size(), nullptr, infoLog.data());
-    std::cout << infoLog;
+    std::cout << infoLog.c_str();
+}
+
+struct ProgramBinaryHeader
+{
+    uint32_t Magic;
+    uint32_t BinaryFormat;
+    uint64_t Key;
+    uint64_t BinarySize;
+};
+
+static constexpr uint32_t PROGRAM_BINARY_MAGIC = 0x42505649; // "IVPB"
+static constexpr std::string_view PROGRAM_BINARY_CACHE_DIRECTORY = "shadercache";
+// binaries that weren't loaded or written for this long belong to shaders or drivers that are gone
+static constexpr auto PROGRAM_BINARY_MAX_AGE = std::chrono::days(30);
+
+// next to the executable by default, so runs started from anywhere share one cache, --program-cache overrides it
+static std::filesystem::path ProgramBinaryCacheDirectory = PROGRAM_BINARY_CACHE_DIRECTORY;
+
+// argv[0] may be relative to the working directory or only a name that was looked up in PATH, the OS knows better where possible
+static std::filesystem::path GetExecutableDirectory(const char* argv0)
+{
+    std::error_code errorCode;
+#ifdef __linux__
+    auto executable = std::filesystem::read_symlink("/proc/self/exe", errorCode);
+    if (!errorCode)
+    {
+        return executable.parent_path();
+    }
+#endif
+    return std::filesystem::absolute(argv0, errorCode).parent_path();
+}
+
+static std::filesystem::path GetProgramBinaryPath(uint64_t key)
+{
+    return ProgramBinaryCacheDirectory / std::format("{:016x}.bin", key);
+}
+
+static void RemoveProgramBinary(uint64_t key)
+{
+    std::error_code errorCode;
+    std::filesystem::remove(GetProgramBinaryPath(key), errorCode);
+}
+
+// removes binaries nothing used for PROGRAM_BINARY_MAX_AGE, other configurations sharing the cache keep theirs as long as they run now and then
+static void PruneProgramBinaries()
+{
+    std::error_code errorCode;
+    const auto oldestKept = std::filesystem::file_time_type::clock::now() - PROGRAM_BINARY_MAX_AGE;
+    for (const auto& entry : std::filesystem::directory_iterator(ProgramBinaryCacheDirectory, errorCode))
+    {
+        auto lastWriteTime = entry.last_write_time(errorCode);
+        if (!errorCode && lastWriteTime < oldestKept)
+        {
+            std::filesystem::remove(entry.path(), errorCode);
+        }
+    }
+}
+
+// returns 0 if there is no cached binary or the driver rejects it
+static uint32_t LoadProgramBinary(uint64_t key)
+{
+    std::string fileData = LoadFile(GetProgramBinaryPath(key).string());
+
+    ProgramBinaryHeader header;
+    if (fileData.size() < sizeof(header))
+    {
+        return 0;
+    }
+
+    std::memcpy(&header, fileData.data(), sizeof(header));
+    if (header.Magic != PROGRAM_BINARY_MAGIC || header.Key != key || header.BinarySize != fileData.size() - sizeof(header))
+    {
+        return 0;
+    }
+
+    auto program = glCreateProgram();
+    glProgramBinary(program, header.BinaryFormat, fileData.data() + sizeof(header), header.BinarySize);
+
+    int linkStatus;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    // marks the binary as in use for PruneProgramBinaries
+    std::error_code errorCode;
+    std::filesystem::last_write_time(GetProgramBinaryPath(key), std::filesystem::file_time_type::clock::now(), errorCode);
+
+    return program;
+}
+
+static void StoreProgramBinary(uint32_t program, uint64_t key)
+{
+    int binaryLength;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+
+    // drivers without any binary formats report a length of zero
+    if (binaryLength == 0)
+    {
+        return;
+    }
+
+    std::string binary(binaryLength, '\0');
+    ProgramBinaryHeader header = {
+        .Magic = PROGRAM_BINARY_MAGIC,
+        .Key = key,
+    };
+    GLsizei writtenLength;
+    glGetProgramBinary(program, binaryLength, &writtenLength, &header.BinaryFormat, binary.data());
+    header.BinarySize = writtenLength;
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(ProgramBinaryCacheDirectory, errorCode);
+
+    // written to a file of its own and renamed, so processes sharing the cache never read a half written binary
+    auto path = GetProgramBinaryPath(key);
+    auto temporaryPath = path;
+    temporaryPath += std::format(".{:08x}.tmp", std::random_device{}());
+    {
+        std::ofstream file{ temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), writtenLength);
+    }
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    if (errorCode)
+    {
+        std::filesystem::remove(temporaryPath, errorCode);
+    }
+}
+
+static bool IsProgramLinked(uint32_t program)
+{
+    int linkStatus;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+struct SpecializationConstant
+{
+    uint32_t ID;
+    uint32_t Value;
+};
+
+// a program that may still be compiling and linking in the background
+struct ProgramBuild
+{
+    std::string Name;
+    std::vector<std::string> Defines;
+    bool UseCache;
+    bool UseSpirv;
+    std::vector<SpecializationConstant> SpecializationConstants; // only for SPIR-V
+
+    uint32_t Program;
+    uint32_t VertexShader;
+    uint32_t FragmentShader;
+    uint64_t CacheKey;
+    bool IsFromCache;
+    bool IsFinished;
+    std::chrono::steady_clock::time_point SubmitTime;
+    float MsBuild; // loading the binary for cached programs, otherwise until the build was first seen complete
+};
+
+// program binaries are keyed by sources, defines, specialization and driver and fall back to compiling when the driver rejects them
+static bool TryLoadCachedProgram(ProgramBuild& build, std::initializer_list<std::string_view> sources)
+{
+    uint64_t key = HashFnv1a(build.UseSpirv ? "SPIR-V" : "GLSL");
+    for (auto source : sources)
+    {
+        key = HashFnv1a(source, key);
+    }
+    for (const auto& define : build.Defines)
+    {
+        key = HashFnv1a(define, key);
+    }
+    for (const auto& constant : build.SpecializationConstants)
+    {
+        key = HashFnv1a(std::format("{}={}", constant.ID, constant.Value), key);
+    }
+    key = HashFnv1a(reinterpret_cast<const char*>(glGetString(GL_RENDERER)), key);
+    key = HashFnv1a(reinterpret_cast<const char*>(glGetString(GL_VERSION)), key);
+    build.CacheKey = key;
+
+    build.Program = LoadProgramBinary(key);
+    build.IsFromCache = build.Program != 0;
+    return build.IsFromCache;
+}
+
+static void LinkProgramBuild(ProgramBuild& build)
+{
+    build.Program = glCreateProgram();
+    glAttachShader(build.Program, build.VertexShader);
+    glAttachShader(build.Program, build.FragmentShader);
+    glProgramParameteri(build.Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(build.Program);
+}
+
+static void SubmitProgramBuild(ProgramBuild& build, std::string_view vertexSrc, std::string_view fragmentSrc)
+{
+    build.SubmitTime = std::chrono::steady_clock::now();
+
+    if (build.UseCache && TryLoadCachedProgram(build, { vertexSrc, fragmentSrc }))
+    {
+        build.MsBuild = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - build.SubmitTime).count();
+        return;
+    }
+
+    // with parallel shader compile none of these calls block, the driver links as soon as the shaders are compiled
+    build.VertexShader = SubmitShader(GL_VERTEX_SHADER, vertexSrc, build.Defines);
+    build.FragmentShader = SubmitShader(GL_FRAGMENT_SHADER, fragmentSrc, build.Defines);
+    LinkProgramBuild(build);
+}
+
+static std::string_view AsBytes(std::span<const uint32_t> words)
+{
+    return std::string_view(reinterpret_cast<const char*>(words.data()), words.size_bytes());
+}
+
+static uint32_t SubmitSpirvShader(GLenum type, std::span<const uint32_t> spirv, std::span<const SpecializationConstant> constants)
+{
+    std::vector<uint32_t> constantIDs;
+    std::vector<uint32_t> constantValues;
+    for (const auto& constant : constants)
+    {
+        constantIDs.push_back(constant.ID);
+        constantValues.push_back(constant.Value);
+    }
+
+    auto shader = glCreateShader(type);
+    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv.data(), spirv.size_bytes());
+    glSpecializeShader(shader, "main", constants.size(), constantIDs.data(), constantValues.data());
 
     return shader;
 }
 
-static std::string LoadFile(std::string_view path)
+// SPIR-V gets specialized instead of compiled, so the driver can constant fold what would otherwise be uniforms
+static void SubmitSpirvProgramBuild(ProgramBuild& build, std::span<const uint32_t> vertexSpirv, std::span<const uint32_t> fragmentSpirv)
 {
-    std::ifstream file{ path.data(), std::ios::in | std::ios::binary };
-    std::string fileData{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
-    return fileData;
+    build.SubmitTime = std::chrono::steady_clock::now();
+
+    if (build.UseCache && TryLoadCachedProgram(build, { AsBytes(vertexSpirv), AsBytes(fragmentSpirv) }))
+    {
+        build.MsBuild = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - build.SubmitTime).count();
+        return;
+    }
+
+    build.VertexShader = SubmitSpirvShader(GL_VERTEX_SHADER, vertexSpirv, build.SpecializationConstants);
+    build.FragmentShader = SubmitSpirvShader(GL_FRAGMENT_SHADER, fragmentSpirv, build.SpecializationConstants);
+    LinkProgramBuild(build);
+}
+
+static bool IsProgramBuildComplete(const ProgramBuild& build)
+{
+    if (build.IsFinished || build.IsFromCache)
+    {
+        return true;
+    }
+
+    // without parallel shader compile there is no way of telling without blocking
+    if (!HasParallelShaderCompile)
+    {
+        return false;
+    }
+
+    int completionStatus;
+    glGetProgramiv(build.Program, GL_COMPLETION_STATUS_KHR, &completionStatus);
+    return completionStatus == GL_TRUE;
+}
+
+// blocks until the program is linked, cached programs were already timed when they got loaded
+static void FinishProgramBuild(ProgramBuild& build)
+{
+    if (build.IsFinished)
+    {
+        return;
+    }
+
+    if (!build.IsFromCache)
+    {
+        PrintShaderInfoLog(build.VertexShader);
+        PrintShaderInfoLog(build.FragmentShader);
+
+        std::string infoLog(4096, '\0');
+        glGetProgramInfoLog(build.Program, infoLog.size(), nullptr, infoLog.data());
+        std::cout << infoLog.c_str();
+
+        glDetachShader(build.Program, build.VertexShader);
+        glDetachShader(build.Program, build.FragmentShader);
+        glDeleteShader(build.VertexShader);
+        glDeleteShader(build.FragmentShader);
+
+        build.MsBuild = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - build.SubmitTime).count();
+    }
+    build.IsFinished = true;
+
+    if (build.UseCache && !build.IsFromCache && IsProgramLinked(build.Program))
+    {
+        StoreProgramBinary(build.Program, build.CacheKey);
+    }
+
+    std::cout << std::format("Built program \"{}\" in {}ms{}\n", build.Name, build.MsBuild, build.IsFromCache ? " (from cache)" : "");
+}
+
+static void PollProgramBuilds(std::span<ProgramBuild> builds)
+{
+    for (auto& build : builds)
+    {
+        if (!build.IsFinished && IsProgramBuildComplete(build))
+        {
+            FinishProgramBuild(build);
+        }
+    }
+}
+
+// only blocks when the requested program isn't done yet, keeps finishing others in the meantime so their build time is accurate
+static uint32_t WaitForProgram(std::span<ProgramBuild> builds, size_t index)
+{
+    if (!HasParallelShaderCompile)
+    {
+        FinishProgramBuild(builds[index]);
+    }
+
+    while (!builds[index].IsFinished)
+    {
+        PollProgramBuilds(builds);
+        if (!builds[index].IsFinished)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    return builds[index].Program;
 }
 
-static float RoundTo(float value, uint32_t decimalPlaces)
+struct WatchedFile
+{
+    std::filesystem::path Path;
+    std::filesystem::file_time_type LastWriteTime;
+};
+
+// true once per modification, a temporarily missing file (editors replacing it on save) doesn't count as a change
+static bool HasFileChanged(WatchedFile& file)
 {
-    auto multiplier = std::pow(10.0f, decimalPlaces);
-    return std::round(value * multiplier) / multiplier;
+    std::error_code errorCode;
+    auto lastWriteTime = std::filesystem::last_write_time(file.Path, errorCode);
+    if (errorCode || lastWriteTime == file.LastWriteTime)
+    {
+        return false;
+    }
+
+    file.LastWriteTime = lastWriteTime;
+    return true;
 }
 
 static void ExitWithMessage(std::string_view message)
@@ -73,84 +524,1270 @@ struct ShaderInfo
     uint32_t IsSubgroupUniform = 1;
 };
 
-static constexpr auto OPENGL_VERSION_MAJOR = 4;
-static constexpr auto OPENGL_VERSION_MINOR = 5;
-auto Width = 1600;
-auto Height = 900;
+// same order as the query targets in PIPELINE_STATISTICS_TARGETS
+struct PipelineStatistics
+{
+    uint64_t VerticesSubmitted;
+    uint64_t VertexShaderInvocations;
+    uint64_t PrimitivesSubmitted;
+    uint64_t ClippingInputPrimitives;
+    uint64_t FragmentShaderInvocations;
+};
 
-int main()
+struct RenderResult
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OPENGL_VERSION_MAJOR);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OPENGL_VERSION_MINOR);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+    float MsElapsed;
+    float MsCpuSubmit;
+    // phases of animating and uploading the transforms, only measured by animated passes
+    float MsCpuFenceWait;
+    float MsCpuAnimate;
+    float MsCpuUpload;
+    ShaderInfo Info;
+    PipelineStatistics Statistics; // only queried by instrumented passes, so the others time the draw alone
+    size_t GpuDrawSpan;
+    uint64_t FrameIndex;
+    size_t PassIndex;
+    size_t OrderPosition; // how many passes were drawn before this one in the same frame
+};
 
-    auto window = glfwCreateWindow(Width, Height, "InstancedVsMultiDrawRendering", nullptr, nullptr);
-    if (window == nullptr)
+// where the vertex shader gets the layout of a triangle from
+enum class PerDrawDataSource
+{
+    Computed, // derived from the index per vertex, no memory access
+    SSBO,
+    UBO,
+    TBO,
+    Attribute, // vertex attribute with a divisor of 1
+};
+
+static constexpr std::array PER_DRAW_DATA_SOURCES =
+{
+    PerDrawDataSource::Computed,
+    PerDrawDataSource::SSBO,
+    PerDrawDataSource::UBO,
+    PerDrawDataSource::TBO,
+    PerDrawDataSource::Attribute,
+};
+
+static std::string_view GetPerDrawDataSourceName(PerDrawDataSource source)
+{
+    switch (source)
+    {
+        case PerDrawDataSource::Computed: return "Computed";
+        case PerDrawDataSource::SSBO: return "SSBO";
+        case PerDrawDataSource::UBO: return "UBO";
+        case PerDrawDataSource::TBO: return "TBO";
+        case PerDrawDataSource::Attribute: return "Attribute";
+    }
+    return "";
+}
+
+// the define selecting the source in vertex.glsl
+static std::string_view GetPerDrawDataSourceDefine(PerDrawDataSource source)
+{
+    switch (source)
+    {
+        case PerDrawDataSource::SSBO: return "TRANSFORM_SOURCE_SSBO";
+        case PerDrawDataSource::UBO: return "TRANSFORM_SOURCE_UBO";
+        case PerDrawDataSource::TBO: return "TRANSFORM_SOURCE_TBO";
+        case PerDrawDataSource::Attribute: return "TRANSFORM_SOURCE_ATTRIBUTE";
+        default: return "";
+    }
+}
+
+// how the animated transforms of a frame get to the GPU
+enum class UploadMethod
+{
+    SubData,
+    Orphaning, // reallocates the storage with glNamedBufferData before the SubData
+    PersistentCoherent,
+    PersistentExplicitFlush,
+};
+
+static constexpr std::array UPLOAD_METHODS =
+{
+    UploadMethod::SubData,
+    UploadMethod::Orphaning,
+    UploadMethod::PersistentCoherent,
+    UploadMethod::PersistentExplicitFlush,
+};
+
+static std::string_view GetUploadMethodName(UploadMethod method)
+{
+    switch (method)
+    {
+        case UploadMethod::SubData: return "SubData";
+        case UploadMethod::Orphaning: return "orphaning";
+        case UploadMethod::PersistentCoherent: return "persistent coherent";
+        case UploadMethod::PersistentExplicitFlush: return "persistent explicit flush";
+    }
+    return "";
+}
+
+struct Pass
+{
+    std::string Name;
+    size_t ProgramBuild;
+    bool IsInstrumented;
+    bool UseDrawID;
+    bool IsSpecialized; // index source and triangle count are baked into the program instead of being uniforms
+    std::optional<size_t> BaselinePass; // the pass whose GPU time this one is compared against
+    PerDrawDataSource DataSource = PerDrawDataSource::Computed;
+    std::optional<UploadMethod> Upload; // animates the transforms every frame and uploads them before drawing
+};
+
+// compile time strategies, each one gets its own program with the index source injected as a define
+struct InstanceIDStrategy
+{
+    static constexpr std::string_view Name = "gl_InstanceID";
+    static constexpr std::string_view IndexSourceDefine = "INDEX_SOURCE_INSTANCE_ID";
+    static constexpr bool UseDrawID = false;
+};
+
+struct DrawIDStrategy
+{
+    static constexpr std::string_view Name = "gl_DrawID";
+    static constexpr std::string_view IndexSourceDefine = "INDEX_SOURCE_DRAW_ID";
+    static constexpr bool UseDrawID = true;
+};
+
+template<typename Strategy>
+static ProgramBuild MakeSpecializedProgramBuild(size_t triangleCount)
+{
+    return ProgramBuild{
+        .Name = std::format("GLSL specialized {}", Strategy::Name),
+        .Defines = { std::string(Strategy::IndexSourceDefine), std::format("TRIANGLE_COUNT {}", triangleCount) },
+    };
+}
+
+template<typename Strategy>
+static Pass MakeSpecializedPass(size_t programBuild, size_t baselinePass)
+{
+    return Pass{
+        .Name = std::format("GLSL specialized {}", Strategy::Name),
+        .ProgramBuild = programBuild,
+        .IsInstrumented = false,
+        .UseDrawID = Strategy::UseDrawID,
+        .IsSpecialized = true,
+        .BaselinePass = baselinePass,
+    };
+}
+
+// layout of a triangle as computed per vertex in vertex.glsl, matches a vec4 in every fetched data source
+struct DrawTransform
+{
+    float TranslationX;
+    float TranslationY;
+    float Scale;
+    float Unused;
+};
+
+// does the same float math as vertex.glsl so both produce identical positions
+static void BuildDrawTransforms(std::span<DrawTransform> transforms)
+{
+    const float scale = 1.0f / std::sqrt(static_cast<float>(transforms.size()));
+
+    size_t i = 0;
+#ifdef USE_SSE2
+    // four transforms per iteration, transposed from structure of arrays into the vec4 layout
+    {
+        const __m128 scales = _mm_set1_ps(scale);
+        __m128 indices = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        for (; i + 4 <= transforms.size(); i += 4)
+        {
+            __m128 x = _mm_mul_ps(indices, scales);
+            // truncation is the same as floor since x is never negative
+            __m128 floorX = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+            __m128 y = _mm_mul_ps(floorX, scales);
+            x = _mm_sub_ps(x, floorX);
+
+            __m128 s = scales;
+            __m128 unused = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, s, unused);
+            _mm_storeu_ps(&transforms[i + 0].TranslationX, x);
+            _mm_storeu_ps(&transforms[i + 1].TranslationX, y);
+            _mm_storeu_ps(&transforms[i + 2].TranslationX, s);
+            _mm_storeu_ps(&transforms[i + 3].TranslationX, unused);
+
+            indices = _mm_add_ps(indices, _mm_set1_ps(4.0f));
+        }
+    }
+#endif
+
+    for (; i < transforms.size(); i++)
+    {
+        float x = static_cast<float>(i) * scale;
+        float floorX = std::floor(x);
+        transforms[i] = {
+            .TranslationX = x - floorX,
+            .TranslationY = floorX * scale,
+            .Scale = scale,
+        };
+    }
+}
+
+// threads which stay alive between frames, starting them for every animation would cost about as much as the animation itself
+struct WorkerPool
+{
+    std::mutex Mutex;
+    std::condition_variable_any WorkAvailable;
+    std::condition_variable WorkDone;
+    const std::function<void(size_t, size_t)>* Job = nullptr;
+    size_t Count = 0;
+    size_t ChunkSize = 0;
+    uint64_t Generation = 0; // incremented for every job, so workers can tell a new one from the one they already ran
+    size_t PendingWorkerCount = 0;
+    std::vector<std::jthread> Threads; // declared last so they get stopped and joined before the rest is destroyed
+};
+
+// the calling thread takes part in every job, so threadCount - 1 workers get started
+static void StartWorkerPool(WorkerPool& pool, size_t threadCount)
+{
+    for (size_t worker = 1; worker < threadCount; worker++)
+    {
+        pool.Threads.emplace_back([&pool, worker](std::stop_token stopToken)
+        {
+            uint64_t finishedGeneration = 0;
+            std::unique_lock lock(pool.Mutex);
+            while (pool.WorkAvailable.wait(lock, stopToken, [&]() { return pool.Generation != finishedGeneration; }))
+            {
+                finishedGeneration = pool.Generation;
+                const auto& job = *pool.Job;
+                const size_t begin = std::min(worker * pool.ChunkSize, pool.Count);
+                const size_t end = std::min(begin + pool.ChunkSize, pool.Count);
+
+                lock.unlock();
+                if (begin < end)
+                {
+                    job(begin, end);
+                }
+                lock.lock();
+
+                if (--pool.PendingWorkerCount == 0)
+                {
+                    pool.WorkDone.notify_one();
+                }
+            }
+        });
+    }
+}
+
+// splits [0, count) into one contiguous range per thread of the pool, the calling thread takes the first one
+static void ParallelFor(WorkerPool& pool, size_t count, const std::function<void(size_t, size_t)>& func)
+{
+    const size_t threadCount = pool.Threads.size() + 1;
+    const size_t chunkSize = (count + threadCount - 1) / threadCount;
+    {
+        std::lock_guard lock(pool.Mutex);
+        pool.Job = &func;
+        pool.Count = count;
+        pool.ChunkSize = chunkSize;
+        pool.PendingWorkerCount = pool.Threads.size();
+        pool.Generation++;
+    }
+    pool.WorkAvailable.notify_all();
+
+    func(0, std::min(chunkSize, count));
+
+    std::unique_lock lock(pool.Mutex);
+    pool.WorkDone.wait(lock, [&]() { return pool.PendingWorkerCount == 0; });
+}
+
+// moves every triangle on a small circle inside of its cell, dst may be write combined mapped memory so it's only written to
+static void AnimateDrawTransforms(WorkerPool& pool, std::span<DrawTransform> dst, std::span<const DrawTransform> src, float time)
+{
+    ParallelFor(pool, src.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const float phase = time + static_cast<float>(i) * 0.1f;
+            const float radius = src[i].Scale * 0.1f;
+            dst[i] = {
+                .TranslationX = src[i].TranslationX + radius * std::cos(phase),
+                .TranslationY = src[i].TranslationY + radius * std::sin(phase),
+                .Scale = src[i].Scale,
+            };
+        }
+    });
+}
+
+struct AnimatedTransformBuffer
+{
+    UploadMethod Method;
+    uint32_t Buffer;
+    size_t SlotSize; // aligned to GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT so each slot can be bound on its own
+    std::byte* MappedData; // persistent methods only
+    std::vector<GLsync> Fences; // one per ring slot, a slot is only written again once the GPU is done reading it
+    size_t Slot;
+};
+
+// persistently mapped buffers are split into ringSize slots, which has to be more than the frames in flight for uploads to never wait on the GPU
+static AnimatedTransformBuffer CreateAnimatedTransformBuffer(UploadMethod method, size_t transformCount, size_t ringSize)
+{
+    AnimatedTransformBuffer animated = {};
+    animated.Method = method;
+    glCreateBuffers(1, &animated.Buffer);
+
+    if (method == UploadMethod::SubData || method == UploadMethod::Orphaning)
+    {
+        // mutable storage, orphaning is not possible with glNamedBufferStorage
+        animated.SlotSize = sizeof(DrawTransform) * transformCount;
+        glNamedBufferData(animated.Buffer, animated.SlotSize, nullptr, GL_STREAM_DRAW);
+        return animated;
+    }
+
+    int alignment;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    animated.SlotSize = (sizeof(DrawTransform) * transformCount + alignment - 1) / alignment * alignment;
+    animated.Fences.resize(ringSize);
+
+    uint32_t flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+    flags |= method == UploadMethod::PersistentCoherent ? GL_MAP_COHERENT_BIT : 0;
+    glNamedBufferStorage(animated.Buffer, animated.SlotSize * ringSize, nullptr, flags);
+
+    uint32_t accessFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+    accessFlags |= method == UploadMethod::PersistentCoherent ? GL_MAP_COHERENT_BIT : GL_MAP_FLUSH_EXPLICIT_BIT;
+    animated.MappedData = static_cast<std::byte*>(glMapNamedBufferRange(animated.Buffer, 0, animated.SlotSize * ringSize, accessFlags));
+
+    return animated;
+}
+
+// CPU time of each phase of an animated upload, so the upload paths can be compared without the animation
+struct AnimatedUpload
+{
+    size_t Offset; // where the transforms of this frame are in the buffer
+    float MsFenceWait;
+    float MsAnimate;
+    float MsUpload;
+};
+
+// animates the transforms of this frame into the buffer
+// persistently mapped buffers get animated into directly, so the cost of writing to mapped memory is part of MsAnimate
+static AnimatedUpload UploadAnimatedTransforms(WorkerPool& pool, AnimatedTransformBuffer& animated, std::span<const DrawTransform> src, std::vector<DrawTransform>& staging, float time)
+{
+    auto getMsSince = [](std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const size_t size = sizeof(DrawTransform) * src.size();
+    AnimatedUpload upload = {};
+
+    if (animated.Method == UploadMethod::SubData || animated.Method == UploadMethod::Orphaning)
+    {
+        auto start = std::chrono::steady_clock::now();
+        staging.resize(src.size());
+        AnimateDrawTransforms(pool, staging, src, time);
+        upload.MsAnimate = getMsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        if (animated.Method == UploadMethod::Orphaning)
+        {
+            glNamedBufferData(animated.Buffer, size, nullptr, GL_STREAM_DRAW);
+        }
+        glNamedBufferSubData(animated.Buffer, 0, size, staging.data());
+        upload.MsUpload = getMsSince(start);
+        return upload;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    animated.Slot = (animated.Slot + 1) % animated.Fences.size();
+    GLsync& fence = animated.Fences[animated.Slot];
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    upload.MsFenceWait = getMsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    upload.Offset = animated.Slot * animated.SlotSize;
+    AnimateDrawTransforms(pool, { reinterpret_cast<DrawTransform*>(animated.MappedData + upload.Offset), src.size() }, src, time);
+    upload.MsAnimate = getMsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    if (animated.Method == UploadMethod::PersistentExplicitFlush)
+    {
+        glFlushMappedNamedBufferRange(animated.Buffer, upload.Offset, size);
+    }
+    upload.MsUpload = getMsSince(start);
+    return upload;
+}
+
+// marks the slot of this frame as in use until the GPU executed every command submitted so far
+static void FenceAnimatedTransforms(AnimatedTransformBuffer& animated)
+{
+    if (animated.MappedData)
+    {
+        animated.Fences[animated.Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+// a phase of a frame on the GPU, bounded by two GL_TIMESTAMP queries
+// timestamps are only written once all previous commands completed, so spans never overlap and gaps are idle or untimed work
+struct GpuSpan
+{
+    std::string Name;
+    uint64_t NsBegin;
+    uint64_t NsEnd;
+};
+
+// timestamp queries of a single frame which get resolved into GpuSpans once the GPU has passed all of them
+struct GpuTimeline
+{
+    uint64_t FrameIndex;
+    std::vector<GpuSpan> Spans;
+    std::vector<uint32_t> Queries; // begin and end query of each span
+};
+
+// results of a frame can only be collected after the GPU signaled its fence
+struct PendingFrame
+{
+    GpuTimeline Timeline;
+    std::vector<RenderResult> Results; // one per drawn Pass in the order they were drawn
+    std::vector<uint32_t> StatisticsQueries; // PIPELINE_STATISTICS_TARGETS.size() per Result of an instrumented Pass
+    size_t ReadbackSlot; // where the ShaderInfo of this frame got copied to
+    GLsync Fence;
+};
+
+static bool IsFrameComplete(const PendingFrame& frame)
+{
+    return glClientWaitSync(frame.Fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+static void WaitForFrame(const PendingFrame& frame)
+{
+    glClientWaitSync(frame.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+}
+
+static uint32_t AcquireTimestampQuery(std::vector<uint32_t>& queryPool)
+{
+    if (queryPool.empty())
+    {
+        uint32_t query;
+        glCreateQueries(GL_TIMESTAMP, 1, &query);
+        return query;
+    }
+
+    auto query = queryPool.back();
+    queryPool.pop_back();
+    return query;
+}
+
+static size_t BeginGpuSpan(GpuTimeline& timeline, std::vector<uint32_t>& queryPool, std::string_view name)
+{
+    timeline.Spans.push_back(GpuSpan{ .Name = std::string(name) });
+    timeline.Queries.push_back(AcquireTimestampQuery(queryPool));
+    timeline.Queries.push_back(AcquireTimestampQuery(queryPool));
+
+    size_t span = timeline.Spans.size() - 1;
+    glQueryCounter(timeline.Queries[span * 2 + 0], GL_TIMESTAMP);
+    return span;
+}
+
+static void EndGpuSpan(GpuTimeline& timeline, size_t span)
+{
+    glQueryCounter(timeline.Queries[span * 2 + 1], GL_TIMESTAMP);
+}
+
+// blocks if the timeline isn't available yet and hands the queries back to the pool
+static void ResolveGpuTimeline(GpuTimeline& timeline, std::vector<uint32_t>& queryPool)
+{
+    for (size_t i = 0; i < timeline.Spans.size(); i++)
+    {
+        glGetQueryObjectui64v(timeline.Queries[i * 2 + 0], GL_QUERY_RESULT, &timeline.Spans[i].NsBegin);
+        glGetQueryObjectui64v(timeline.Queries[i * 2 + 1], GL_QUERY_RESULT, &timeline.Spans[i].NsEnd);
+    }
+
+    queryPool.insert(queryPool.end(), timeline.Queries.begin(), timeline.Queries.end());
+    timeline.Queries.clear();
+}
+
+static float GetSpanMs(const GpuSpan& span)
+{
+    return (span.NsEnd - span.NsBegin) / 1000000.0f;
+}
+
+// trace event JSON as understood by chrome://tracing and ui.perfetto.dev
+struct TraceFile
+{
+    std::ofstream File;
+    std::chrono::steady_clock::time_point CpuOrigin;
+    int64_t NsGpuOrigin;
+    bool IsFirstEvent = true;
+};
+
+static constexpr auto TRACE_THREAD_ID_CPU = 1;
+static constexpr auto TRACE_THREAD_ID_GPU = 2;
+
+static void WriteTraceEvent(TraceFile& trace, std::string_view json)
+{
+    trace.File << (trace.IsFirstEvent ? "\n" : ",\n") << json;
+    trace.IsFirstEvent = false;
+}
+
+static void BeginTrace(TraceFile& trace, std::string_view path)
+{
+    trace.File.open(path.data(), std::ios::out | std::ios::trunc);
+    if (!trace.File)
+    {
+        ExitWithMessage(std::format("Failed to open trace file \"{}\". ", path));
+    }
+
+    // GPU timestamps are put on the CPU time axis by sampling both clocks at the same time
+    trace.CpuOrigin = std::chrono::steady_clock::now();
+    glGetInteger64v(GL_TIMESTAMP, &trace.NsGpuOrigin);
+
+    trace.File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    WriteTraceEvent(trace, std::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"CPU"}}}})", TRACE_THREAD_ID_CPU));
+    WriteTraceEvent(trace, std::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"GPU"}}}})", TRACE_THREAD_ID_GPU));
+}
+
+static void EndTrace(TraceFile& trace)
+{
+    trace.File << "\n]}\n";
+    trace.File.close();
+}
+
+static void WriteTraceSpan(TraceFile& trace, std::string_view name, int threadID, double usBegin, double usDuration)
+{
+    WriteTraceEvent(trace, std::format(R"({{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})", name, threadID, usBegin, usDuration));
+}
+
+static void WriteCpuTraceSpan(TraceFile& trace, std::string_view name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    WriteTraceSpan(trace, name, TRACE_THREAD_ID_CPU, Microseconds(begin - trace.CpuOrigin).count(), Microseconds(end - begin).count());
+}
+
+static void WriteGpuTraceSpan(TraceFile& trace, const GpuSpan& span)
+{
+    double usBegin = (static_cast<int64_t>(span.NsBegin) - trace.NsGpuOrigin) / 1000.0;
+    WriteTraceSpan(trace, span.Name, TRACE_THREAD_ID_GPU, usBegin, (span.NsEnd - span.NsBegin) / 1000.0);
+}
+
+static std::vector<float> GetSamples(std::span<const RenderResult> results, float RenderResult::* timing)
+{
+    std::vector<float> samples;
+    samples.reserve(results.size());
+    for (const auto& result : results)
+    {
+        samples.push_back(result.*timing);
+    }
+    return samples;
+}
+
+static TimingStatistics ComputeStatistics(std::span<const RenderResult> results, float RenderResult::* timing)
+{
+    return ComputeStatistics(GetSamples(results, timing));
+}
+
+static constexpr std::array<GLenum, 5> PIPELINE_STATISTICS_TARGETS =
+{
+    GL_VERTICES_SUBMITTED,
+    GL_VERTEX_SHADER_INVOCATIONS,
+    GL_PRIMITIVES_SUBMITTED,
+    GL_CLIPPING_INPUT_PRIMITIVES,
+    GL_FRAGMENT_SHADER_INVOCATIONS,
+};
+static_assert(sizeof(PipelineStatistics) == sizeof(uint64_t) * PIPELINE_STATISTICS_TARGETS.size());
+
+// initialized during static initialization, which is as close to process start as portable code gets
+static const auto ProcessStartTime = std::chrono::steady_clock::now();
+
+struct StartupPhase
+{
+    std::string Name;
+    float MsDuration;
+};
+
+// consecutive phases from process start to the first measured frame
+struct StartupProfile
+{
+    std::chrono::steady_clock::time_point LastPhaseEnd = ProcessStartTime;
+    std::vector<StartupPhase> Phases;
+};
+
+static void EndStartupPhase(StartupProfile& profile, std::string_view name)
+{
+    auto now = std::chrono::steady_clock::now();
+    profile.Phases.push_back({ std::string(name), std::chrono::duration<float, std::milli>(now - profile.LastPhaseEnd).count() });
+    profile.LastPhaseEnd = now;
+}
+
+static float GetStartupMs(const StartupProfile& profile)
+{
+    return std::chrono::duration<float, std::milli>(profile.LastPhaseEnd - ProcessStartTime).count();
+}
+
+static constexpr std::string_view VERTEX_SHADER_NAME = "vertex.glsl";
+static constexpr std::string_view FRAGMENT_SHADER_NAME = "fragment.glsl";
+
+// hot reloading needs files to watch, which are taken from here unless --shader-dir says otherwise
+static constexpr std::string_view DEFAULT_SHADER_DIRECTORY = "res/shaders";
+
+// shaders are embedded into the executable by EmbedShaders.ps1, a directory can be given to load them from files instead
+static std::string LoadShaderSource(std::string_view shaderDirectory, std::string_view name)
+{
+    if (!shaderDirectory.empty())
+    {
+        return LoadFile((std::filesystem::path(shaderDirectory) / name).string());
+    }
+
+    for (const auto& shader : EMBEDDED_SHADERS)
+    {
+        if (shader.Name == name)
+        {
+            return std::string(shader.Source);
+        }
+    }
+    return {};
+}
+
+// precompiled by EmbedShaders.ps1 with the defines joined by spaces, empty when glslangValidator wasn't available at build time
+static std::span<const uint32_t> FindEmbeddedSpirv(std::string_view name, std::span<const std::string> defines)
+{
+    std::string joinedDefines;
+    for (const auto& define : defines)
+    {
+        joinedDefines += joinedDefines.empty() ? define : ' ' + define;
+    }
+
+    for (const auto& spirv : EMBEDDED_SPIRV)
+    {
+        if (spirv.Name == name && spirv.Defines == joinedDefines)
+        {
+            return spirv.Words;
+        }
+    }
+    return {};
+}
+
+static constexpr std::array PASS_ORDERS = { PassOrder::Fixed, PassOrder::ABBA, PassOrder::Randomized, PassOrder::Blocks };
+
+static constexpr uint64_t PASS_ORDER_BLOCK_FRAMES = 32;
+
+static std::string_view GetPassOrderName(PassOrder order)
+{
+    switch (order)
+    {
+        case PassOrder::Fixed: return "fixed";
+        case PassOrder::ABBA: return "abba";
+        case PassOrder::Randomized: return "random";
+        case PassOrder::Blocks: return "blocks";
+    }
+    return "";
+}
+
+// indices of the passes drawn in a frame in the order they are drawn
+static std::vector<size_t> GetFramePassOrder(PassOrder order, size_t passCount, uint64_t frameIndex, std::mt19937& random)
+{
+    std::vector<size_t> passOrder(passCount);
+    std::iota(passOrder.begin(), passOrder.end(), 0);
+
+    switch (order)
+    {
+        case PassOrder::Fixed:
+            break;
+        case PassOrder::ABBA:
+            if (frameIndex % 2 == 1)
+            {
+                std::reverse(passOrder.begin(), passOrder.end());
+            }
+            break;
+        case PassOrder::Randomized:
+            std::shuffle(passOrder.begin(), passOrder.end(), random);
+            break;
+        case PassOrder::Blocks:
+            return { (frameIndex / PASS_ORDER_BLOCK_FRAMES) % passCount };
+    }
+
+    return passOrder;
+}
+
+// adaptive sampling needs a cap, since noisy drivers might never reach the target
+static constexpr float DEFAULT_ADAPTIVE_MAX_SECONDS = 60.0f;
+
+static Settings ParseArguments(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc)
+        {
+            settings.TracePath = argv[++i];
+        }
+        else if (arg == "--results" && i + 1 < argc)
+        {
+            settings.ResultsPath = argv[++i];
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            settings.FrameCount = std::stoull(argv[++i]);
+        }
+        else if (arg == "--no-program-cache")
+        {
+            settings.UseProgramCache = false;
+        }
+        else if (arg == "--program-cache" && i + 1 < argc)
+        {
+            settings.ProgramCacheDirectory = argv[++i];
+        }
+        else if (arg == "--shader-dir" && i + 1 < argc)
+        {
+            settings.ShaderDirectory = argv[++i];
+        }
+        else if (arg == "--hot-reload")
+        {
+            settings.HotReloadShaders = true;
+        }
+        else if (arg == "--draw-count" && i + 1 < argc)
+        {
+            settings.DrawCount = std::stoull(argv[++i]);
+        }
+        else if (arg == "--animate")
+        {
+            settings.AnimateTransforms = true;
+        }
+        else if (arg == "--frames-in-flight" && i + 1 < argc)
+        {
+            settings.FramesInFlight = std::stoull(argv[++i]);
+        }
+        else if (arg == "--order" && i + 1 < argc)
+        {
+            std::string_view name = argv[++i];
+            auto order = std::find_if(PASS_ORDERS.begin(), PASS_ORDERS.end(), [&](PassOrder order) { return GetPassOrderName(order) == name; });
+            if (order == PASS_ORDERS.end())
+            {
+                ExitWithMessage(std::format("Unknown pass order \"{}\", expected fixed, abba, random or blocks. ", name));
+            }
+            settings.Order = *order;
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            settings.Seed = std::stoul(argv[++i]);
+        }
+        else if (arg == "--target-ci" && i + 1 < argc)
+        {
+            settings.TargetConfidenceIntervalPercent = std::stof(argv[++i]);
+        }
+        else if (arg == "--max-time" && i + 1 < argc)
+        {
+            settings.MaxSeconds = std::stof(argv[++i]);
+        }
+        else if (arg == "--baseline" && i + 1 < argc)
+        {
+            settings.BaselinePassName = argv[++i];
+        }
+        else if (arg == "--compare" && i + 2 < argc)
+        {
+            settings.CompareBaselinePath = argv[++i];
+            settings.CompareResultsPath = argv[++i];
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            settings.RegressionThresholdPercent = std::stof(argv[++i]);
+        }
+        else if (arg == "--llvmpipe-sweep")
+        {
+            settings.LlvmpipeSweep = true;
+        }
+        else if (arg == "--sweep" && i + 1 < argc)
+        {
+            std::string_view drawCounts = argv[++i];
+            for (size_t begin = 0; begin < drawCounts.size();)
+            {
+                size_t end = std::min(drawCounts.find(',', begin), drawCounts.size());
+                settings.SweepDrawCounts.push_back(std::stoull(std::string(drawCounts.substr(begin, end - begin))));
+                begin = end + 1;
+            }
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            settings.WorkerCount = std::stoull(argv[++i]);
+        }
+        else if (arg == "--hidden")
+        {
+            settings.HiddenWindow = true;
+        }
+        else
+        {
+            ExitWithMessage(std::format("Unknown argument \"{}\". Usage: InstancedVsMultiDrawRendering [--results <file.tsv>] [--frames <count>] [--trace <file.json>] [--no-program-cache] [--program-cache <directory>] [--shader-dir <directory>] [--hot-reload] [--draw-count <count>] [--animate] [--frames-in-flight <count>] [--order fixed|abba|random|blocks] [--seed <seed>] [--target-ci <percent>] [--max-time <seconds>] [--baseline <pass name>] [--compare <baseline.tsv|directory> <results.tsv> [--threshold <percent>]] [--llvmpipe-sweep] [--sweep <draw count,...> [--workers <count>]] [--hidden]\n", arg));
+        }
+    }
+
+    if (settings.HotReloadShaders && settings.ShaderDirectory.empty())
+    {
+        settings.ShaderDirectory = DEFAULT_SHADER_DIRECTORY;
+    }
+
+    if (settings.TargetConfidenceIntervalPercent > 0.0f && settings.MaxSeconds == 0.0f)
+    {
+        settings.MaxSeconds = DEFAULT_ADAPTIVE_MAX_SECONDS;
+    }
+
+    // every run of the llvmpipe sweep would start a nested draw count sweep of its own
+    if (settings.LlvmpipeSweep && !settings.SweepDrawCounts.empty())
+    {
+        ExitWithMessage("--llvmpipe-sweep and --sweep can't be combined, sweep the draw counts with --draw-count per llvmpipe sweep instead. ");
+    }
+
+    return settings;
+}
+
+// GL_KHR_shader_subgroup isn't part of the generated glad loader
+#ifndef GL_SUBGROUP_SIZE_KHR
+#define GL_SUBGROUP_SIZE_KHR 0x9532
+#define GL_SUBGROUP_SUPPORTED_STAGES_KHR 0x9533
+#define GL_SUBGROUP_SUPPORTED_FEATURES_KHR 0x9534
+#define GL_SUBGROUP_QUAD_ALL_STAGES_KHR 0x9535
+#endif
+
+// the brand string of the x86 CPUID leaves 0x80000002 to 0x80000004
+static std::string GetCpuModel()
+{
+    std::array<uint32_t, 12> brand = {};
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    std::array<int, 4> registers;
+    __cpuid(registers.data(), 0x80000000);
+    if (static_cast<uint32_t>(registers[0]) < 0x80000004)
+    {
+        return "Unknown";
+    }
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        __cpuid(reinterpret_cast<int*>(&brand[i * 4]), 0x80000002 + i);
+    }
+#elif defined(__x86_64__) || defined(__i386__)
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        if (!__get_cpuid(0x80000002 + i, &brand[i * 4 + 0], &brand[i * 4 + 1], &brand[i * 4 + 2], &brand[i * 4 + 3]))
+        {
+            return "Unknown";
+        }
+    }
+#else
+    return "Unknown";
+#endif
+
+    std::string model(reinterpret_cast<const char*>(brand.data()), strnlen(reinterpret_cast<const char*>(brand.data()), sizeof(brand)));
+    model.erase(0, model.find_first_not_of(' '));
+    model.erase(model.find_last_not_of(' ') + 1);
+    return model;
+}
+
+// environment variables which change how Mesa's drivers render, llvmpipe in particular
+static constexpr std::array MESA_ENVIRONMENT_VARIABLES =
+{
+    "LP_NUM_THREADS",
+    "GALLIUM_DRIVER",
+    "LIBGL_ALWAYS_SOFTWARE",
+    "MESA_LOADER_DRIVER_OVERRIDE",
+    "MESA_GL_VERSION_OVERRIDE",
+    "MESA_GLSL_VERSION_OVERRIDE",
+    "MESA_NO_ERROR",
+};
+
+// everything about the host that makes results of different machines comparable, as name and value
+static std::vector<std::pair<std::string, std::string>> CollectEnvironment()
+{
+    std::vector<std::pair<std::string, std::string>> environment;
+
+    auto addString = [&](std::string_view name, GLenum property)
+    {
+        environment.push_back({ std::string(name), reinterpret_cast<const char*>(glGetString(property)) });
+    };
+    addString("GL_VENDOR", GL_VENDOR);
+    addString("GL_RENDERER", GL_RENDERER);
+    addString("GL_VERSION", GL_VERSION);
+    addString("GL_SHADING_LANGUAGE_VERSION", GL_SHADING_LANGUAGE_VERSION);
+
+    std::string extensions;
+    {
+        int extensionCount;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (int i = 0; i < extensionCount; i++)
+        {
+            extensions += std::format("{}{}", i > 0 ? " " : "", reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+        }
+    }
+    environment.push_back({ "GL_EXTENSIONS", extensions });
+
+    auto addInteger = [&](std::string_view name, GLenum property)
+    {
+        int64_t value;
+        glGetInteger64v(property, &value);
+        environment.push_back({ std::string(name), std::to_string(value) });
+    };
+    addInteger("GL_MAX_SHADER_STORAGE_BLOCK_SIZE", GL_MAX_SHADER_STORAGE_BLOCK_SIZE);
+    addInteger("GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS", GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS);
+    addInteger("GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS", GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS);
+    addInteger("GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT", GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT);
+    addInteger("GL_MAX_UNIFORM_BLOCK_SIZE", GL_MAX_UNIFORM_BLOCK_SIZE);
+    addInteger("GL_MAX_VERTEX_UNIFORM_BLOCKS", GL_MAX_VERTEX_UNIFORM_BLOCKS);
+    addInteger("GL_MAX_TEXTURE_BUFFER_SIZE", GL_MAX_TEXTURE_BUFFER_SIZE);
+    addInteger("GL_MAX_VERTEX_ATTRIBS", GL_MAX_VERTEX_ATTRIBS);
+    addInteger("GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS", GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS);
+
+    if (IsExtensionSupported("GL_KHR_shader_subgroup"))
+    {
+        addInteger("GL_SUBGROUP_SIZE_KHR", GL_SUBGROUP_SIZE_KHR);
+        addInteger("GL_SUBGROUP_SUPPORTED_STAGES_KHR", GL_SUBGROUP_SUPPORTED_STAGES_KHR);
+        addInteger("GL_SUBGROUP_SUPPORTED_FEATURES_KHR", GL_SUBGROUP_SUPPORTED_FEATURES_KHR);
+        addInteger("GL_SUBGROUP_QUAD_ALL_STAGES_KHR", GL_SUBGROUP_QUAD_ALL_STAGES_KHR);
+    }
+
+    environment.push_back({ "CPU", GetCpuModel() });
+    environment.push_back({ "Hardware threads", std::to_string(std::thread::hardware_concurrency()) });
+
+    for (const char* name : MESA_ENVIRONMENT_VARIABLES)
+    {
+        if (auto value = ReadEnvironmentVariable(name))
+        {
+            environment.push_back({ name, *value });
+        }
+    }
+
+    return environment;
+}
+
+// tab separated records, the first column names the kind of record
+static void WriteResults(const Settings& settings, std::span<const std::pair<std::string, std::string>> environment, const StartupProfile& startupProfile, std::span<const ProgramBuild> programBuilds, std::span<const Pass> passes, std::span<const std::vector<RenderResult>> passResults, std::span<const float> msFrameTimes)
+{
+    std::ofstream file{ settings.ResultsPath, std::ios::out | std::ios::trunc };
+    if (!file)
+    {
+        ExitWithMessage(std::format("Failed to open results file \"{}\". ", settings.ResultsPath));
+    }
+
+    for (const auto& [name, value] : environment)
+    {
+        file << std::format("environment\t{}\t{}\n", name, value);
+    }
+    file << std::format("environment\tPass order\t{}\n", GetPassOrderName(settings.Order));
+    file << std::format("environment\tSeed\t{}\n", settings.Seed);
+
+    for (const auto& phase : startupProfile.Phases)
+    {
+        file << std::format("startup\t{}\t{}\n", phase.Name, phase.MsDuration);
+    }
+    file << std::format("startup\tTotal\t{}\n", GetStartupMs(startupProfile));
+
+    file << "# program\tname\tbuild ms\tfrom cache\n";
+    for (const auto& build : programBuilds)
+    {
+        file << std::format("program\t{}\t{}\t{}\n", build.Name, build.MsBuild, build.IsFromCache);
+    }
+
+    file << "# sample\tpass\tdraw count\tframe\tposition\tGPU ms\tCPU submit ms\tCPU fence wait ms\tCPU animate ms\tCPU upload ms\n";
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        for (const auto& result : passResults[i])
+        {
+            file << std::format("sample\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n", passes[i].Name, settings.DrawCount, result.FrameIndex, result.OrderPosition,
+                result.MsElapsed, result.MsCpuSubmit, result.MsCpuFenceWait, result.MsCpuAnimate, result.MsCpuUpload);
+        }
+    }
+
+    file << "# summary\tpass\tsamples\tmedian GPU ms\tCI low ms\tCI high ms\n";
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        TimingStatistics statistics = ComputeStatistics(passResults[i], &RenderResult::MsElapsed);
+        file << std::format("summary\t{}\t{}\t{}\t{}\t{}\n", passes[i].Name, statistics.SampleCount, statistics.Median, statistics.MedianLow, statistics.MedianHigh);
+    }
+
+    file << "# frame\tframe\tCPU frame ms\n";
+    for (size_t i = 0; i < msFrameTimes.size(); i++)
+    {
+        file << std::format("frame\t{}\t{}\n", i, msFrameTimes[i]);
+    }
+}
+
+// vertices of the subgroup calibration draw are 3 times this, enough to fill every subgroup many times over
+static constexpr auto SUBGROUP_CALIBRATION_TRIANGLES = 4096;
+
+// how often adaptive sampling checks whether the confidence intervals are narrow enough
+static constexpr uint64_t ADAPTIVE_CHECK_INTERVAL_FRAMES = 16;
+
+// how often shader files are checked for modifications when hot reloading
+static constexpr auto SHADER_WATCH_INTERVAL = std::chrono::milliseconds(250);
+
+static constexpr auto OPENGL_VERSION_MAJOR = 4;
+static constexpr auto OPENGL_VERSION_MINOR = 5;
+auto Width = 1600;
+auto Height = 900;
+
+int main(int argc, char** argv)
+{
+    Settings settings = ParseArguments(argc, argv);
+    if (!settings.CompareResultsPath.empty())
+    {
+        return CompareResults(settings);
+    }
+    if (settings.LlvmpipeSweep)
+    {
+        return RunLlvmpipeSweep(settings, argc, argv);
+    }
+    if (!settings.SweepDrawCounts.empty())
+    {
+        return RunSweep(settings, argc, argv);
+    }
+
+    ProgramBinaryCacheDirectory = settings.ProgramCacheDirectory.empty()
+        ? GetExecutableDirectory(argv[0]) / PROGRAM_BINARY_CACHE_DIRECTORY
+        : std::filesystem::path(settings.ProgramCacheDirectory);
+
+    StartupProfile startupProfile;
+    EndStartupPhase(startupProfile, "Process start");
+
+    glfwInit();
+    EndStartupPhase(startupProfile, "glfwInit");
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, OPENGL_VERSION_MAJOR);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, OPENGL_VERSION_MINOR);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+    // sweep workers get their context from a window that is never shown
+    glfwWindowHint(GLFW_VISIBLE, settings.HiddenWindow ? GLFW_FALSE : GLFW_TRUE);
+
+    auto window = glfwCreateWindow(Width, Height, "InstancedVsMultiDrawRendering", nullptr, nullptr);
+    if (window == nullptr)
+    {
+        std::string formatted = std::format("Window creation failed. Make sure you have OpenGL {}.{} support. ", OPENGL_VERSION_MAJOR, OPENGL_VERSION_MINOR);
+        ExitWithMessage(formatted);
+    }
+
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height)
+    {
+        Width = width;
+        Height = height;
+        glViewport(0, 0, Width, Height);
+    });
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    EndStartupPhase(startupProfile, "Window and context creation");
+
+    gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    EndStartupPhase(startupProfile, "gladLoadGLLoader");
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_MULTISAMPLE);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(MessageCallback, 0);
+
+    // pixel ownership of a window that is never shown is up to the implementation, which may discard its fragments
+    // hidden windows therefore render into a framebuffer of their own, so sweep runs do the same work as visible ones
+    uint32_t renderFramebuffer = 0;
+    if (settings.HiddenWindow)
+    {
+        uint32_t colorRenderbuffer;
+        glCreateRenderbuffers(1, &colorRenderbuffer);
+        glNamedRenderbufferStorage(colorRenderbuffer, GL_RGBA8, Width, Height);
+
+        glCreateFramebuffers(1, &renderFramebuffer);
+        glNamedFramebufferRenderbuffer(renderFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+        if (glCheckNamedFramebufferStatus(renderFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            ExitWithMessage("Offscreen framebuffer for the hidden window is incomplete. ");
+        }
+        glViewport(0, 0, Width, Height);
+    }
+
+    // bind a dummy VAO since drawing without one is not allowed by OpenGL
+    uint32_t dummyVao;
+    {
+        glCreateVertexArrays(1, &dummyVao);
+        glBindVertexArray(dummyVao);
+    }
+
+    const size_t triangleCount = settings.DrawCount;
+
+    // hardcoded uniform locations in the shader program
+    constexpr auto uniformLocationUseDrawID = 0;
+    constexpr auto uniformLocationCount = 1;
+    // hardcoded specialization constant IDs in the SPIR-V shader program
+    constexpr auto specializationIDUseDrawID = 0;
+    constexpr auto specializationIDCount = 1;
+    // the instrumented program collects ShaderInfo, the uninstrumented one only draws so that the cost of the ballots and atomics can be separated out
+    constexpr size_t instrumentedProgram = 0;
+    constexpr size_t uninstrumentedProgram = 1;
+    // the specialized programs have no uniforms, which removes the per-frame uniform updates and the branch on the index source
+    constexpr size_t specializedInstanceIDProgram = 2;
+    constexpr size_t specializedDrawIDProgram = 3;
+    std::vector<ProgramBuild> programBuilds =
+    {
+        { .Name = "Instrumented", .Defines = { "COLLECT_SHADER_INFO" } },
+        { .Name = "Uninstrumented", .Defines = {} },
+        MakeSpecializedProgramBuild<InstanceIDStrategy>(triangleCount),
+        MakeSpecializedProgramBuild<DrawIDStrategy>(triangleCount),
+    };
+
+    // fetch precomputed per-draw transforms by index instead of computing the layout per vertex, one program per data source
+    std::vector<std::pair<PerDrawDataSource, size_t>> dataSourcePrograms;
+    // the UBO array is sized at compile time and has to fit into a single uniform block, more transforms get drawn in chunks of this size
+    size_t uboChunkSize;
+    {
+        int maxUniformBlockSize;
+        int uniformBufferOffsetAlignment;
+        glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxUniformBlockSize);
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferOffsetAlignment);
+
+        // every chunk gets bound at a multiple of the chunk size, which therefore has to keep the offsets aligned
+        const size_t alignmentTransforms = std::max<size_t>(uniformBufferOffsetAlignment / sizeof(DrawTransform), 1);
+        uboChunkSize = maxUniformBlockSize / sizeof(DrawTransform);
+        uboChunkSize = std::min(uboChunkSize - uboChunkSize % alignmentTransforms, triangleCount);
+
+        for (auto source : PER_DRAW_DATA_SOURCES)
+        {
+            if (source == PerDrawDataSource::Computed)
+            {
+                continue;
+            }
+
+            std::vector<std::string> defines = { std::string(GetPerDrawDataSourceDefine(source)) };
+            if (source == PerDrawDataSource::UBO)
+            {
+                defines.push_back(std::format("TRANSFORM_UBO_SIZE {}", uboChunkSize));
+            }
+
+            dataSourcePrograms.push_back({ source, programBuilds.size() });
+            programBuilds.push_back({ .Name = std::format("{} transform fetch", GetPerDrawDataSourceName(source)), .Defines = std::move(defines) });
+        }
+    }
+
+    // SPIR-V programs need one specialization per index source, they are skipped if the driver or build can't provide them
+    const size_t spirvInstanceIDProgram = programBuilds.size();
+    const size_t spirvDrawIDProgram = programBuilds.size() + 1;
+    const std::vector<std::string> specializedDefines = { "SPECIALIZED" };
+    bool isSpirvAvailable = GLAD_GL_VERSION_4_6 &&
+        !FindEmbeddedSpirv(VERTEX_SHADER_NAME, specializedDefines).empty() &&
+        !FindEmbeddedSpirv(FRAGMENT_SHADER_NAME, specializedDefines).empty();
+    if (isSpirvAvailable)
+    {
+        for (bool useDrawID : { false, true })
+        {
+            programBuilds.push_back({
+                .Name = useDrawID ? "SPIR-V gl_DrawID" : "SPIR-V gl_InstanceID",
+                .Defines = specializedDefines,
+                .UseSpirv = true,
+                .SpecializationConstants =
+                {
+                    { specializationIDUseDrawID, useDrawID },
+                    { specializationIDCount, static_cast<uint32_t>(triangleCount) },
+                },
+            });
+        }
+    }
+    else
     {
-        std::string formatted = std::format("Window creation failed. Make sure you have OpenGL {}.{} support. ", OPENGL_VERSION_MAJOR, OPENGL_VERSION_MINOR);
-        ExitWithMessage(formatted);
+        std::cout << "SPIR-V passes are skipped, they need OpenGL 4.6 and shaders precompiled with glslangValidator at build time.\n";
     }
 
-    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height)
+    // dispatches to GLSL or SPIR-V, SPIR-V is precompiled and therefore not affected by --shader-dir
+    auto submitProgramBuild = [](ProgramBuild& build, std::string_view vertexSrc, std::string_view fragmentSrc)
     {
-        Width = width;
-        Height = height;
-        glViewport(0, 0, Width, Height);
-    });
+        if (build.UseSpirv)
+        {
+            SubmitSpirvProgramBuild(build, FindEmbeddedSpirv(VERTEX_SHADER_NAME, build.Defines), FindEmbeddedSpirv(FRAGMENT_SHADER_NAME, build.Defines));
+        }
+        else
+        {
+            SubmitProgramBuild(build, vertexSrc, fragmentSrc);
+        }
 
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(0);
-    gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+        // without parallel shader compile completion can't be polled, so each build is finished right away to time it alone
+        if (!HasParallelShaderCompile)
+        {
+            FinishProgramBuild(build);
+        }
+    };
+    {
+        auto vertexSrc = LoadShaderSource(settings.ShaderDirectory, VERTEX_SHADER_NAME);
+        auto fragmentSrc = LoadShaderSource(settings.ShaderDirectory, FRAGMENT_SHADER_NAME);
+        if (vertexSrc.empty() || fragmentSrc.empty())
+        {
+            auto source = settings.ShaderDirectory.empty() ? std::string("the executable") : std::filesystem::absolute(settings.ShaderDirectory).string();
+            ExitWithMessage(std::format("Failed to load shaders from {}. ", source));
+        }
+        EndStartupPhase(startupProfile, "Shader loading");
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_MULTISAMPLE);
-    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-    glDebugMessageCallback(MessageCallback, 0);
+        // all permutations get submitted up front, so with parallel shader compile the driver builds them concurrently
+        InitParallelShaderCompile();
+        for (auto& build : programBuilds)
+        {
+            build.UseCache = settings.UseProgramCache;
+            submitProgramBuild(build, vertexSrc, fragmentSrc);
+        }
+        EndStartupPhase(startupProfile, "Shader submission");
 
-    // bind a dummy VAO since drawing without one is not allowed by OpenGL
-    {
-        uint32_t vao;
-        glCreateVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+        // waited for here so compiling and linking get a phase of their own instead of landing in whichever phase first uses a program
+        for (size_t i = 0; i < programBuilds.size(); i++)
+        {
+            WaitForProgram(programBuilds, i);
+        }
+        EndStartupPhase(startupProfile, "Shader compile and link");
     }
 
-    // hardcoded uniform locations in the shader program
-    constexpr auto uniformLocationUseDrawID = 0;
-    constexpr auto uniformLocationCount = 1;
-    uint32_t program;
+    // every strategy owns an immutable indirect buffer, so nothing gets uploaded between passes that could make them wait on each other
+    auto createDrawCmdBuffer = [](std::span<const DrawArraysIndirectCommand> drawCmds)
     {
-        auto fileData = LoadFile("res/shaders/vertex.glsl");
-        auto vertexShader = MakeShader(GL_VERTEX_SHADER, fileData.data());
-
-        fileData = LoadFile("res/shaders/fragment.glsl");
-        auto fragmentShader = MakeShader(GL_FRAGMENT_SHADER, fileData.data());
+        uint32_t buffer;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, drawCmds.size_bytes(), drawCmds.data(), 0);
+        return buffer;
+    };
 
-        program = glCreateProgram();
-        glAttachShader(program, vertexShader);
-        glAttachShader(program, fragmentShader);
-        glLinkProgram(program);
-
-        std::string infoLog(4096, '\0');
-        glGetProgramInfoLog(program, infoLog.size(), nullptr, infoLog.data());
-        std::cout << infoLog;
+    // a single mesh with one instance per triangle
+    uint32_t instancedDrawCmdBuffer;
+    {
+        DrawArraysIndirectCommand drawCmd = {
+            .Count = 3,
+            .InstanceCount = static_cast<uint32_t>(triangleCount),
+            .First = 0,
+            .BaseInstance = 0,
+        };
+        instancedDrawCmdBuffer = createDrawCmdBuffer({ &drawCmd, 1 });
     }
 
-    // set up draw commands for all triangles
-    uint32_t drawCmdBuffer;
-    std::vector<DrawArraysIndirectCommand> drawCmds(10'000); // number of triangles - prefer square numbers
+    // one mesh per triangle with a single instance
+    uint32_t multiDrawCmdBuffer;
+    uint32_t baseInstanceMultiDrawCmdBuffer;
     {
+        std::vector<DrawArraysIndirectCommand> drawCmds(triangleCount);
         std::fill(drawCmds.begin(), drawCmds.end(), DrawArraysIndirectCommand {
             .Count = 3,
             .InstanceCount = 1,
             .First = 0,
             .BaseInstance = 0,
         });
+        multiDrawCmdBuffer = createDrawCmdBuffer(drawCmds);
+
+        // divisor attributes are indexed by instance + BaseInstance, so for multi draws each command selects its attribute through BaseInstance
+        for (size_t i = 0; i < drawCmds.size(); i++)
+        {
+            drawCmds[i].BaseInstance = i;
+        }
+        baseInstanceMultiDrawCmdBuffer = createDrawCmdBuffer(drawCmds);
+    }
 
-        glCreateBuffers(1, &drawCmdBuffer);
-        glNamedBufferStorage(drawCmdBuffer, sizeof(DrawArraysIndirectCommand) * drawCmds.size(), drawCmds.data(), GL_DYNAMIC_STORAGE_BIT);
+    // one instanced draw per UBO chunk, gl_InstanceID doesn't include BaseInstance so every chunk starts at instance 0
+    uint32_t uboChunkInstancedDrawCmdBuffer;
+    {
+        std::vector<DrawArraysIndirectCommand> drawCmds;
+        for (size_t first = 0; first < triangleCount; first += uboChunkSize)
+        {
+            drawCmds.push_back({
+                .Count = 3,
+                .InstanceCount = static_cast<uint32_t>(std::min(uboChunkSize, triangleCount - first)),
+                .First = 0,
+                .BaseInstance = 0,
+            });
+        }
+        uboChunkInstancedDrawCmdBuffer = createDrawCmdBuffer(drawCmds);
     }
 
     // SSBO used for getting back data from the vertex shader
@@ -162,85 +1799,575 @@ int main()
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, shaderInfoBuffer);
     }
 
-    // timer query for measuring rendering time
-    uint32_t timerQuery;
+    // the layout of every triangle, the same buffer backs all fetched data sources
+    std::vector<DrawTransform> transforms(triangleCount);
+    uint32_t transformBuffer;
+    uint32_t transformTexture;
+    uint32_t transformAttributeVao;
+    {
+        BuildDrawTransforms(transforms);
+
+        // padded to whole UBO chunks, a uniform block backed by less than its declared size is undefined behavior even if the rest isn't read
+        std::vector<DrawTransform> paddedTransforms = transforms;
+        paddedTransforms.resize((triangleCount + uboChunkSize - 1) / uboChunkSize * uboChunkSize);
+
+        glCreateBuffers(1, &transformBuffer);
+        glNamedBufferStorage(transformBuffer, sizeof(DrawTransform) * paddedTransforms.size(), paddedTransforms.data(), 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, transformBuffer);
+
+        glCreateTextures(GL_TEXTURE_BUFFER, 1, &transformTexture);
+        glTextureBuffer(transformTexture, GL_RGBA32F, transformBuffer);
+        glBindTextureUnit(0, transformTexture);
+
+        glCreateVertexArrays(1, &transformAttributeVao);
+        glVertexArrayVertexBuffer(transformAttributeVao, 0, transformBuffer, 0, sizeof(DrawTransform));
+        glVertexArrayBindingDivisor(transformAttributeVao, 0, 1);
+        glEnableVertexArrayAttrib(transformAttributeVao, 1);
+        glVertexArrayAttribFormat(transformAttributeVao, 1, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(transformAttributeVao, 1, 0);
+    }
+
+    // one buffer per upload method, the animation is computed from the static transforms every frame
+    std::vector<AnimatedTransformBuffer> animatedTransformBuffers;
+    std::vector<DrawTransform> animationStaging;
+    WorkerPool animationWorkers;
+    if (settings.AnimateTransforms)
     {
-        glCreateQueries(GL_TIME_ELAPSED, 1, &timerQuery);
+        StartWorkerPool(animationWorkers, std::max(std::thread::hardware_concurrency(), 1u));
+        for (auto method : UPLOAD_METHODS)
+        {
+            animatedTransformBuffers.push_back(CreateAnimatedTransformBuffer(method, triangleCount, settings.FramesInFlight + 1));
+        }
+    }
+
+    // pipeline statistics queries for verifying vertex reuse and rasterization work independently of ShaderInfo, reused once their frame got collected
+    // core since 4.6, older drivers only have them with the ARB extension and the passes are measured without them otherwise
+    const bool hasPipelineStatistics = GLAD_GL_VERSION_4_6 || IsExtensionSupported("GL_ARB_pipeline_statistics_query");
+    if (!hasPipelineStatistics)
+    {
+        std::cout << "Pipeline statistics are skipped, they need OpenGL 4.6 or GL_ARB_pipeline_statistics_query.\n";
     }
+    std::array<std::vector<uint32_t>, PIPELINE_STATISTICS_TARGETS.size()> pipelineStatisticsQueryPools;
+
+    EndStartupPhase(startupProfile, "Buffer and query creation");
 
+    auto environment = CollectEnvironment();
+    EndStartupPhase(startupProfile, "Environment collection");
 
-    while (!glfwWindowShouldClose(window))
+    // gl_SubgroupSize is what the compiler reports, on Intel vertex shaders may actually run with fewer lanes (e.g. wave8 while reporting 32)
+    // the widest ballot of a draw whose vertices pack subgroups fully is the number of lanes that really run concurrently
+    uint32_t calibratedSubgroupWidth;
     {
-        constexpr float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-        glClearNamedFramebufferfv(0, GL_COLOR, 0, clearColor);
+        const bool hasSubgroupProperties = IsExtensionSupported("GL_KHR_shader_subgroup");
+        int subgroupSize = 0;
+        int subgroupStages = 0;
+        if (hasSubgroupProperties)
+        {
+            glGetIntegerv(GL_SUBGROUP_SIZE_KHR, &subgroupSize);
+            glGetIntegerv(GL_SUBGROUP_SUPPORTED_STAGES_KHR, &subgroupStages);
+        }
+
+        auto program = WaitForProgram(programBuilds, instrumentedProgram);
+        glUseProgram(program);
+        glProgramUniform1ui(program, uniformLocationUseDrawID, false);
+        glProgramUniform1i(program, uniformLocationCount, triangleCount);
+
+        // a single instance of many vertices, nothing gets rasterized
+        glEnable(GL_RASTERIZER_DISCARD);
+        glDrawArrays(GL_TRIANGLES, 0, 3 * SUBGROUP_CALIBRATION_TRIANGLES);
+        glDisable(GL_RASTERIZER_DISCARD);
+
+        ShaderInfo calibrationInfo;
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glGetNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &calibrationInfo);
+        ShaderInfo info{};
+        glNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &info);
+
+        calibratedSubgroupWidth = std::max(calibrationInfo.SubgroupMaxActiveLanes, 1u);
+        environment.push_back({ "Calibrated vertex shader subgroup width", std::to_string(calibratedSubgroupWidth) });
+
+        std::cout << "Subgroup calibration:\n";
+        if (hasSubgroupProperties)
+        {
+            std::cout << std::format("* GL_SUBGROUP_SIZE_KHR...........: {}\n", subgroupSize);
+            std::cout << std::format("* Vertex shader subgroups........: {}\n", (subgroupStages & GL_VERTEX_SHADER_BIT) ? "Supported" : "Not supported");
+        }
+        std::cout << std::format("* gl_SubgroupSize................: {}\n", calibrationInfo.SubgroupSize);
+        std::cout << std::format("* Measured active lanes..........: {}\n", calibratedSubgroupWidth);
+        if (calibratedSubgroupWidth < calibrationInfo.SubgroupSize)
+        {
+            std::cout << "Vertex shaders run with fewer lanes than gl_SubgroupSize, SubgroupUtilization is reported against the measured width.\n";
+        }
+        std::cout << '\n';
+    }
+    EndStartupPhase(startupProfile, "Subgroup calibration");
+
+    // each pass draws all triangles, timings of the uninstrumented ones show the pure draw cost
+    constexpr size_t uninstrumentedInstanceIDPass = 2;
+    constexpr size_t uninstrumentedDrawIDPass = 3;
+    std::vector<Pass> passes =
+    {
+        { "gl_InstanceID", instrumentedProgram, true, false },
+        { "gl_DrawID", instrumentedProgram, true, true },
+        { "Uninstrumented gl_InstanceID", uninstrumentedProgram, false, false },
+        { "Uninstrumented gl_DrawID", uninstrumentedProgram, false, true },
+        MakeSpecializedPass<InstanceIDStrategy>(specializedInstanceIDProgram, uninstrumentedInstanceIDPass),
+        MakeSpecializedPass<DrawIDStrategy>(specializedDrawIDProgram, uninstrumentedDrawIDPass),
+    };
+    std::optional<size_t> ssboTransformProgram;
+    std::optional<size_t> ssboTransformInstanceIDPass;
+    for (auto [source, program] : dataSourcePrograms)
+    {
+        for (bool useDrawID : { false, true })
+        {
+            if (source == PerDrawDataSource::SSBO && !useDrawID)
+            {
+                ssboTransformProgram = program;
+                ssboTransformInstanceIDPass = passes.size();
+            }
+            passes.push_back({
+                .Name = std::format("{} transform {}", GetPerDrawDataSourceName(source), useDrawID ? "gl_DrawID" : "gl_InstanceID"),
+                .ProgramBuild = program,
+                .IsInstrumented = false,
+                .UseDrawID = useDrawID,
+                .IsSpecialized = false,
+                .BaselinePass = useDrawID ? uninstrumentedDrawIDPass : uninstrumentedInstanceIDPass,
+                .DataSource = source,
+            });
+        }
+    }
+    // animated instance streams are drawn instanced and read through the SSBO, compared against the static SSBO transforms
+    if (settings.AnimateTransforms)
+    {
+        for (auto method : UPLOAD_METHODS)
+        {
+            passes.push_back({
+                .Name = std::format("Animated {} gl_InstanceID", GetUploadMethodName(method)),
+                .ProgramBuild = *ssboTransformProgram,
+                .IsInstrumented = false,
+                .UseDrawID = false,
+                .IsSpecialized = false,
+                .BaselinePass = ssboTransformInstanceIDPass,
+                .DataSource = PerDrawDataSource::SSBO,
+                .Upload = method,
+            });
+        }
+    }
+    if (isSpirvAvailable)
+    {
+        passes.push_back({ "SPIR-V specialized gl_InstanceID", spirvInstanceIDProgram, false, false, true, uninstrumentedInstanceIDPass });
+        passes.push_back({ "SPIR-V specialized gl_DrawID", spirvDrawIDProgram, false, true, true, uninstrumentedDrawIDPass });
+    }
+
+    // a chosen baseline replaces the baseline of every pass
+    if (!settings.BaselinePassName.empty())
+    {
+        auto baseline = std::find_if(passes.begin(), passes.end(), [&](const Pass& pass) { return pass.Name == settings.BaselinePassName; });
+        if (baseline == passes.end())
+        {
+            ExitWithMessage(std::format("Unknown baseline pass \"{}\". ", settings.BaselinePassName));
+        }
+
+        const size_t baselinePass = baseline - passes.begin();
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            passes[i].BaselinePass = i == baselinePass ? std::nullopt : std::optional(baselinePass);
+        }
+    }
+
+    // the ShaderInfo of every pass gets copied into the slot of its frame and is only read once the frame completed
+    // one slot more than frames in flight, so the frame being submitted never overwrites one that is still pending
+    const size_t readbackSlotCount = settings.FramesInFlight + 1;
+    uint32_t shaderInfoReadbackBuffer;
+    {
+        glCreateBuffers(1, &shaderInfoReadbackBuffer);
+        glNamedBufferStorage(shaderInfoReadbackBuffer, sizeof(ShaderInfo) * passes.size() * readbackSlotCount, nullptr, GL_CLIENT_STORAGE_BIT);
+    }
+    auto getShaderInfoReadbackOffset = [&](size_t readbackSlot, size_t passIndex)
+    {
+        return sizeof(ShaderInfo) * (readbackSlot * passes.size() + passIndex);
+    };
+
+    // CPU spans are written as they happen, GPU spans once their timeline got resolved
+    TraceFile trace;
+    if (!settings.TracePath.empty())
+    {
+        BeginTrace(trace, settings.TracePath);
+    }
+    auto traceCpuSpan = [&](std::string_view name, std::chrono::steady_clock::time_point begin)
+    {
+        if (trace.File.is_open())
+        {
+            WriteCpuTraceSpan(trace, name, begin, std::chrono::steady_clock::now());
+        }
+    };
+
+    // GL_TIMESTAMP queries of resolved timelines get reused
+    std::vector<uint32_t> timestampQueryPool;
+
+    // draws the triangles either as a single mesh but multiple instances or as multiple meshes but a single instance
+    auto renderTriangles = [&](size_t passIndex, PendingFrame& frame)
+    {
+        const Pass& pass = passes[passIndex];
+        GpuTimeline& timeline = frame.Timeline;
+        RenderResult result = {};
 
-        glProgramUniform1i(program, uniformLocationCount, drawCmds.size());
+        // measure CPU time of the submission itself, which excludes the query calls around the draw
+        std::chrono::steady_clock::duration cpuSubmitTime;
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCmdBuffer);
+        auto program = WaitForProgram(programBuilds, pass.ProgramBuild);
+        if (!pass.IsSpecialized)
+        {
+            glProgramUniform1i(program, uniformLocationCount, triangleCount);
+        }
+
+        if (pass.Upload)
+        {
+            auto animationSpan = BeginGpuSpan(timeline, timestampQueryPool, std::format("Animate {}", pass.Name));
+            auto animationStart = std::chrono::steady_clock::now();
+            AnimatedTransformBuffer& animated = animatedTransformBuffers[static_cast<size_t>(*pass.Upload)];
+            AnimatedUpload upload = UploadAnimatedTransforms(animationWorkers, animated, transforms, animationStaging, timeline.FrameIndex / 60.0f);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, animated.Buffer, upload.Offset, sizeof(DrawTransform) * transforms.size());
+            result.MsCpuFenceWait = upload.MsFenceWait;
+            result.MsCpuAnimate = upload.MsAnimate;
+            result.MsCpuUpload = upload.MsUpload;
+            EndGpuSpan(timeline, animationSpan);
+            traceCpuSpan(std::format("Animate {}", pass.Name), animationStart);
+        }
+
+        auto bindSpan = BeginGpuSpan(timeline, timestampQueryPool, std::format("Bind {}", pass.Name));
+        auto cpuStart = std::chrono::steady_clock::now();
+        // tell shader program to use gl_DrawID or gl_InstanceID
         glUseProgram(program);
+        if (!pass.IsSpecialized)
+        {
+            glProgramUniform1ui(program, uniformLocationUseDrawID, pass.UseDrawID);
+        }
+
+        const bool isAttributeSource = pass.DataSource == PerDrawDataSource::Attribute;
+        const bool isUboSource = pass.DataSource == PerDrawDataSource::UBO;
+        glBindVertexArray(isAttributeSource ? transformAttributeVao : dummyVao);
+        if (pass.UseDrawID)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, isAttributeSource ? baseInstanceMultiDrawCmdBuffer : multiDrawCmdBuffer);
+        }
+        else
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, isUboSource ? uboChunkInstancedDrawCmdBuffer : instancedDrawCmdBuffer);
+        }
+        cpuSubmitTime = std::chrono::steady_clock::now() - cpuStart;
+        EndGpuSpan(timeline, bindSpan);
+        traceCpuSpan(std::format("Bind {}", pass.Name), cpuStart);
+
+        // only the instrumented passes report the counters, every other pass times the draw without queries open
+        const bool isQueryingStatistics = hasPipelineStatistics && pass.IsInstrumented;
+        for (size_t i = 0; isQueryingStatistics && i < PIPELINE_STATISTICS_TARGETS.size(); i++)
+        {
+            auto& queryPool = pipelineStatisticsQueryPools[i];
+            uint32_t query;
+            if (queryPool.empty())
+            {
+                glCreateQueries(PIPELINE_STATISTICS_TARGETS[i], 1, &query);
+            }
+            else
+            {
+                query = queryPool.back();
+                queryPool.pop_back();
+            }
+            frame.StatisticsQueries.push_back(query);
+            glBeginQuery(PIPELINE_STATISTICS_TARGETS[i], query);
+        }
+        result.GpuDrawSpan = BeginGpuSpan(timeline, timestampQueryPool, std::format("Draw {}", pass.Name));
+        cpuStart = std::chrono::steady_clock::now();
+        if (isUboSource)
+        {
+            // gl_DrawID and gl_InstanceID restart at 0 with every draw, so they index the chunk that is bound
+            for (size_t first = 0; first < triangleCount; first += uboChunkSize)
+            {
+                const size_t count = std::min(uboChunkSize, triangleCount - first);
+                const size_t firstCmd = pass.UseDrawID ? first : first / uboChunkSize;
+                glBindBufferRange(GL_UNIFORM_BUFFER, 0, transformBuffer, sizeof(DrawTransform) * first, sizeof(DrawTransform) * uboChunkSize);
+                glMultiDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void*>(sizeof(DrawArraysIndirectCommand) * firstCmd), pass.UseDrawID ? count : 1, sizeof(DrawArraysIndirectCommand));
+            }
+        }
+        else
+        {
+            glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, pass.UseDrawID ? triangleCount : 1, sizeof(DrawArraysIndirectCommand));
+        }
+        cpuSubmitTime += std::chrono::steady_clock::now() - cpuStart;
+        EndGpuSpan(timeline, result.GpuDrawSpan);
+        traceCpuSpan(std::format("Draw {}", pass.Name), cpuStart);
+        for (size_t i = 0; isQueryingStatistics && i < PIPELINE_STATISTICS_TARGETS.size(); i++)
+        {
+            glEndQuery(PIPELINE_STATISTICS_TARGETS[i]);
+        }
+
+        if (pass.Upload)
+        {
+            FenceAnimatedTransforms(animatedTransformBuffers[static_cast<size_t>(*pass.Upload)]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, transformBuffer);
+        }
+
+        result.MsCpuSubmit = std::chrono::duration<float, std::milli>(cpuSubmitTime).count();
+
+        // copy measurings out of the SSBO on the GPU and reset it, they are read back once the frame completed
+        if (pass.IsInstrumented)
+        {
+            auto resetSpan = BeginGpuSpan(timeline, timestampQueryPool, std::format("Copy and reset ShaderInfo {}", pass.Name));
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glCopyNamedBufferSubData(shaderInfoBuffer, shaderInfoReadbackBuffer, 0, getShaderInfoReadbackOffset(frame.ReadbackSlot, passIndex), sizeof(ShaderInfo));
+            ShaderInfo info{};
+            glNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &info);
+            EndGpuSpan(timeline, resetSpan);
+        }
+
+        result.PassIndex = passIndex;
+        result.OrderPosition = frame.Results.size();
+        frame.Results.push_back(result);
+    };
+
+    // results of every pass and frame since data was last printed and of all frames for the results file
+    std::vector<std::vector<RenderResult>> passResults(passes.size());
+    std::vector<std::vector<RenderResult>> allPassResults(passes.size());
+    std::deque<PendingFrame> pendingFrames;
+    GpuTimeline lastResolvedTimeline = {};
+    uint64_t frameIndex = 0;
+    std::mt19937 passOrderRandom(settings.Seed);
+    // CPU time of every loop iteration, the throughput with the configured number of frames in flight
+    std::vector<float> msFrameTimes;
+    std::vector<float> msRecentFrameTimes;
+
+    // collect results of all frames the GPU completed, only wait when more than maxPendingFrames are in flight
+    auto collectResolvedFrames = [&](size_t maxPendingFrames)
+    {
+        while (!pendingFrames.empty() && (pendingFrames.size() > maxPendingFrames || IsFrameComplete(pendingFrames.front())))
+        {
+            PendingFrame& resolvedFrame = pendingFrames.front();
+            if (pendingFrames.size() > maxPendingFrames)
+            {
+                auto waitStart = std::chrono::steady_clock::now();
+                WaitForFrame(resolvedFrame);
+                traceCpuSpan(std::format("Wait for frame {}", resolvedFrame.Timeline.FrameIndex), waitStart);
+            }
+            glDeleteSync(resolvedFrame.Fence);
+            ResolveGpuTimeline(resolvedFrame.Timeline, timestampQueryPool);
+
+            size_t statisticsQuery = 0;
+            for (RenderResult& result : resolvedFrame.Results)
+            {
+                const size_t i = result.PassIndex;
+                result.MsElapsed = GetSpanMs(resolvedFrame.Timeline.Spans[result.GpuDrawSpan]);
+                result.FrameIndex = resolvedFrame.Timeline.FrameIndex;
+
+                if (passes[i].IsInstrumented)
+                {
+                    glGetNamedBufferSubData(shaderInfoReadbackBuffer, getShaderInfoReadbackOffset(resolvedFrame.ReadbackSlot, i), sizeof(ShaderInfo), &result.Info);
+                }
+
+                auto statistics = reinterpret_cast<uint64_t*>(&result.Statistics);
+                for (size_t j = 0; hasPipelineStatistics && passes[i].IsInstrumented && j < PIPELINE_STATISTICS_TARGETS.size(); j++)
+                {
+                    uint32_t query = resolvedFrame.StatisticsQueries[statisticsQuery++];
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &statistics[j]);
+                    pipelineStatisticsQueryPools[j].push_back(query);
+                }
+
+                passResults[i].push_back(result);
+                allPassResults[i].push_back(result);
+            }
 
+            if (trace.File.is_open())
+            {
+                for (const auto& span : resolvedFrame.Timeline.Spans)
+                {
+                    WriteGpuTraceSpan(trace, span);
+                }
+            }
+
+            lastResolvedTimeline = std::move(resolvedFrame.Timeline);
+            pendingFrames.pop_front();
+        }
+    };
 
-        float msInstancedRendering = 0.0f;
-        ShaderInfo shaderInfoInstancedRendering = {};
-        // draw the triangles as a single mesh but multiple instances
+    // rebuilds all permutations from the current files and only swaps them in if every one of them links
+    auto reloadPrograms = [&]()
+    {
+        auto vertexSrc = LoadShaderSource(settings.ShaderDirectory, VERTEX_SHADER_NAME);
+        auto fragmentSrc = LoadShaderSource(settings.ShaderDirectory, FRAGMENT_SHADER_NAME);
+
+        std::vector<ProgramBuild> reloadedBuilds;
+        for (const auto& build : programBuilds)
         {
-            // tell shader program to use gl_InstanceID
-            glProgramUniform1ui(program, uniformLocationUseDrawID, false);
+            auto& reloadedBuild = reloadedBuilds.emplace_back(ProgramBuild{
+                .Name = build.Name,
+                .Defines = build.Defines,
+                .UseCache = build.UseCache,
+                .UseSpirv = build.UseSpirv,
+                .SpecializationConstants = build.SpecializationConstants,
+            });
+            submitProgramBuild(reloadedBuild, vertexSrc, fragmentSrc);
+        }
 
-            drawCmds[0].InstanceCount = drawCmds.size();
-            glNamedBufferSubData(drawCmdBuffer, 0, sizeof(DrawArraysIndirectCommand), drawCmds.data());
+        bool isEveryProgramLinked = true;
+        for (size_t i = 0; i < reloadedBuilds.size(); i++)
+        {
+            isEveryProgramLinked &= IsProgramLinked(WaitForProgram(reloadedBuilds, i));
+        }
 
-            glBeginQuery(GL_TIME_ELAPSED, timerQuery);
-            glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, 1, sizeof(DrawArraysIndirectCommand));
-            glEndQuery(GL_TIME_ELAPSED);
+        // frames in flight may still use the old programs, OpenGL defers their deletion until they aren't anymore
+        auto& discardedBuilds = isEveryProgramLinked ? programBuilds : reloadedBuilds;
+        for (const auto& build : discardedBuilds)
+        {
+            glDeleteProgram(build.Program);
+        }
 
-            // retrieve measurings from SSBO and reset it
+        if (isEveryProgramLinked)
+        {
+            // every save produces new keys, the binaries of the replaced sources would otherwise pile up until they get too old
+            for (size_t i = 0; i < programBuilds.size(); i++)
             {
-                glGetNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &shaderInfoInstancedRendering);
-                ShaderInfo info{};
-                glNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &info);
+                if (programBuilds[i].UseCache && programBuilds[i].CacheKey != reloadedBuilds[i].CacheKey)
+                {
+                    RemoveProgramBinary(programBuilds[i].CacheKey);
+                }
             }
 
-            // retrieve rendering time
+            // don't mix timings of the old and new shaders, frames still in flight were drawn with the old ones
+            collectResolvedFrames(0);
+            for (auto& results : passResults)
             {
-                uint64_t nsTimeElapsed;
-                glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nsTimeElapsed);
-                msInstancedRendering = nsTimeElapsed / 1000000.0f;
+                results.clear();
             }
+            for (auto& results : allPassResults)
+            {
+                results.clear();
+            }
+            msFrameTimes.clear();
+            msRecentFrameTimes.clear();
+
+            programBuilds = std::move(reloadedBuilds);
+            std::cout << "Reloaded shaders.\n\n";
+        }
+        else
+        {
+            std::cout << "Reloading shaders failed, keeping the previous programs.\n\n";
+        }
+    };
+
+    std::vector<WatchedFile> watchedShaderFiles;
+    auto lastShaderWatchTime = std::chrono::steady_clock::now();
+    if (settings.HotReloadShaders)
+    {
+        watchedShaderFiles =
+        {
+            { std::filesystem::path(settings.ShaderDirectory) / VERTEX_SHADER_NAME },
+            { std::filesystem::path(settings.ShaderDirectory) / FRAGMENT_SHADER_NAME },
+        };
+        for (auto& file : watchedShaderFiles)
+        {
+            HasFileChanged(file);
         }
+    }
+
+    const auto samplingStart = std::chrono::steady_clock::now();
+    std::string_view samplingStopReason = "Window closed";
+    auto isEveryPassPrecise = [&]()
+    {
+        return std::all_of(allPassResults.begin(), allPassResults.end(), [&](const auto& results)
+        {
+            TimingStatistics statistics = ComputeStatistics(results, &RenderResult::MsElapsed);
+            return statistics.SampleCount >= MIN_CONFIDENCE_INTERVAL_SAMPLES && GetConfidenceIntervalPercent(statistics) <= settings.TargetConfidenceIntervalPercent;
+        });
+    };
+
+    // time to first sample ends once the results of the first frame are in, but never before the first swap so the phases stay in order
+    bool isFirstSampleMissing = true;
+    auto endStartupProfile = [&](std::string_view lastPhase)
+    {
+        EndStartupPhase(startupProfile, lastPhase);
 
-        float msMeshRendering = 0.0f;
-        ShaderInfo shaderInfoMeshRendering = {};
-        // draw the triangles as multiple meshes but a single instance
+        std::cout << std::format("Startup took {}ms until the first sample:\n", RoundTo(GetStartupMs(startupProfile), 3));
+        for (const auto& phase : startupProfile.Phases)
         {
-            // tell shader program to use gl_DrawID
-            glProgramUniform1ui(program, uniformLocationUseDrawID, true);
+            std::cout << std::format("* {:.<31}: {}ms\n", phase.Name, RoundTo(phase.MsDuration, 3));
+        }
+        std::cout << '\n';
+
+        isFirstSampleMissing = false;
+    };
+
+    while (!glfwWindowShouldClose(window) && (settings.FrameCount == 0 || frameIndex < settings.FrameCount))
+    {
+        auto frameStart = std::chrono::steady_clock::now();
 
-            drawCmds[0].InstanceCount = 1;
-            glNamedBufferSubData(drawCmdBuffer, 0, sizeof(DrawArraysIndirectCommand), drawCmds.data());
+        // builds finishing in the background get timestamped within a frame instead of whenever a pass first waits for them
+        PollProgramBuilds(programBuilds);
 
-            glBeginQuery(GL_TIME_ELAPSED, timerQuery);
-            glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, drawCmds.size(), sizeof(DrawArraysIndirectCommand));
-            glEndQuery(GL_TIME_ELAPSED);
+        // programs only get swapped between frames
+        if (settings.HotReloadShaders && frameStart - lastShaderWatchTime >= SHADER_WATCH_INTERVAL)
+        {
+            lastShaderWatchTime = frameStart;
 
-            // retrieve measurings from SSBO and reset it
+            bool hasShaderChanged = false;
+            for (auto& file : watchedShaderFiles)
             {
-                glGetNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &shaderInfoMeshRendering);
-                ShaderInfo info{};
-                glNamedBufferSubData(shaderInfoBuffer, 0, sizeof(ShaderInfo), &info);
+                hasShaderChanged |= HasFileChanged(file);
             }
 
-            // retrieve rendering time
+            if (hasShaderChanged)
             {
-                uint64_t nsTimeElapsed;
-                glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nsTimeElapsed);
-                msMeshRendering = nsTimeElapsed / 1000000.0f;
+                reloadPrograms();
             }
         }
 
+        PendingFrame frame = {};
+        frame.Timeline.FrameIndex = frameIndex++;
+        frame.ReadbackSlot = frame.Timeline.FrameIndex % readbackSlotCount;
+
+        auto clearSpan = BeginGpuSpan(frame.Timeline, timestampQueryPool, "Clear");
+        constexpr float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearNamedFramebufferfv(renderFramebuffer, GL_COLOR, 0, clearColor);
+        EndGpuSpan(frame.Timeline, clearSpan);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, renderFramebuffer);
+
+        for (size_t passIndex : GetFramePassOrder(settings.Order, passes.size(), frame.Timeline.FrameIndex, passOrderRandom))
+        {
+            renderTriangles(passIndex, frame);
+        }
+        frame.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pendingFrames.push_back(std::move(frame));
+
+        if (frameIndex == 1)
+        {
+            EndStartupPhase(startupProfile, "First frame submission");
+        }
+
+        auto resolveStart = std::chrono::steady_clock::now();
+        collectResolvedFrames(settings.FramesInFlight);
+        traceCpuSpan("Resolve GPU timelines", resolveStart);
+
+        // sorting every sample of every pass isn't free, so precision is only checked every few frames
+        if (settings.TargetConfidenceIntervalPercent > 0.0f && frameIndex % ADAPTIVE_CHECK_INTERVAL_FRAMES == 0 && isEveryPassPrecise())
+        {
+            samplingStopReason = "Confidence interval target reached";
+            glfwSetWindowShouldClose(window, true);
+        }
+        if (settings.MaxSeconds > 0.0f && std::chrono::duration<float>(std::chrono::steady_clock::now() - samplingStart).count() >= settings.MaxSeconds)
+        {
+            samplingStopReason = "Time limit reached";
+            glfwSetWindowShouldClose(window, true);
+        }
+
+        // with blocks ordering only some of the passes have results
+        const bool hasResults = std::any_of(passResults.begin(), passResults.end(), [](const auto& results) { return !results.empty(); });
+        if (isFirstSampleMissing && hasResults && frameIndex > 1)
+        {
+            endStartupProfile("Waiting for first sample");
+        }
+
         static bool writeFirstTime = true;
-        if (writeFirstTime || glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+        if ((writeFirstTime || glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) && hasResults)
         {
             if (writeFirstTime)
             {
@@ -254,25 +2381,123 @@ int main()
             auto lineLength = desiredHeadingLength - glRenderer.size();
             std::string padding(lineLength / 2, '-');
 
-            auto vertexShaderInvocations = 3 * drawCmds.size();
+            auto formatTiming = [](const TimingStatistics& statistics)
+            {
+                return std::format("{}ms (95% CI {}ms to {}ms, min {}ms, max {}ms, {} samples)",
+                    RoundTo(statistics.Median, decimalPlacesTimings),
+                    RoundTo(statistics.MedianLow, decimalPlacesTimings),
+                    RoundTo(statistics.MedianHigh, decimalPlacesTimings),
+                    RoundTo(statistics.Min, decimalPlacesTimings),
+                    RoundTo(statistics.Max, decimalPlacesTimings),
+                    statistics.SampleCount);
+            };
+
             std::cout << padding << ' ' << glRenderer << ' ' << padding << '\n';
+            for (size_t i = 0; i < passes.size(); i++)
+            {
+                const Pass& pass = passes[i];
+                std::span<const RenderResult> results = passResults[i];
+                if (results.empty())
+                {
+                    continue;
+                }
+                const RenderResult& last = results.back();
+
+                std::cout << pass.Name << '\n';
+                std::cout << std::format("* GPU time.......................: {}\n", formatTiming(ComputeStatistics(results, &RenderResult::MsElapsed)));
+                std::cout << std::format("* CPU submission.................: {}\n", formatTiming(ComputeStatistics(results, &RenderResult::MsCpuSubmit)));
+                if (pass.Upload)
+                {
+                    std::cout << std::format("* CPU fence wait.................: {}\n", formatTiming(ComputeStatistics(results, &RenderResult::MsCpuFenceWait)));
+                    std::cout << std::format("* CPU animation..................: {}\n", formatTiming(ComputeStatistics(results, &RenderResult::MsCpuAnimate)));
+                    std::cout << std::format("* CPU upload.....................: {}\n", formatTiming(ComputeStatistics(results, &RenderResult::MsCpuUpload)));
+                }
+                if (pass.IsInstrumented)
+                {
+                    std::cout << std::format("* Detected as subgroup-uniform...: {}\n", last.Info.IsSubgroupUniform ? "Yes" : "No");
+                    std::cout << std::format("* SubgroupCount..................: {}\n", last.Info.SubgroupCount);
+                    std::cout << std::format("* SubgroupUtilization............: {}/{} (gl_SubgroupSize {})\n", last.Info.SubgroupMaxActiveLanes, calibratedSubgroupWidth, last.Info.SubgroupSize);
+                }
+                if (pass.IsInstrumented && hasPipelineStatistics)
+                {
+                    std::cout << std::format("* Average active lanes...........: {}%\n",
+                        RoundTo(100.0f * last.Statistics.VertexShaderInvocations / (std::max(last.Info.SubgroupCount, 1u) * calibratedSubgroupWidth), 1));
+                    std::cout << std::format("* VerticesSubmitted..............: {}\n", last.Statistics.VerticesSubmitted);
+                    std::cout << std::format("* VertexShaderInvocations........: {}\n", last.Statistics.VertexShaderInvocations);
+                    std::cout << std::format("* PrimitivesSubmitted............: {}\n", last.Statistics.PrimitivesSubmitted);
+                    std::cout << std::format("* ClippingInputPrimitives........: {}\n", last.Statistics.ClippingInputPrimitives);
+                    std::cout << std::format("* FragmentShaderInvocations......: {}\n", last.Statistics.FragmentShaderInvocations);
+                }
+                std::cout << '\n';
+            }
+
+            // speedup > 1 means the pass is faster than its baseline
+            std::cout << "Speedup of GPU time compared to baseline\n";
+            for (size_t i = 0; i < passes.size(); i++)
+            {
+                if (!passes[i].BaselinePass || passResults[i].empty() || passResults[*passes[i].BaselinePass].empty())
+                {
+                    continue;
+                }
+
+                size_t baselinePass = *passes[i].BaselinePass;
+                std::vector<float> msPass = GetSamples(passResults[i], &RenderResult::MsElapsed);
+                std::vector<float> msBaseline = GetSamples(passResults[baselinePass], &RenderResult::MsElapsed);
+                auto [speedupLow, speedupHigh] = ComputeSpeedupInterval(msPass, msBaseline, settings.Seed);
+                double pValue = ComputeMannWhitneyPValue(msPass, msBaseline);
+                std::cout << std::format("* {:.<31}: {}x vs {} (95% CI {}x to {}x, p = {:.4f}){}\n",
+                    passes[i].Name,
+                    RoundTo(GetMedian(msBaseline) / GetMedian(msPass), 3),
+                    passes[baselinePass].Name,
+                    RoundTo(speedupLow, 3),
+                    RoundTo(speedupHigh, 3),
+                    pValue,
+                    pValue < SIGNIFICANCE_LEVEL ? "" : " NOT SIGNIFICANT");
+            }
+            std::cout << '\n';
+
+            // median GPU time of every data source crossed with every index source
+            std::cout << std::format("{:<35}{:>15}{:>15}\n", "Per-draw data source", "gl_InstanceID", "gl_DrawID");
+            for (auto source : PER_DRAW_DATA_SOURCES)
             {
-                std::cout << std::format("* Rendering with gl_InstanceID...: {}ms\n", RoundTo(msInstancedRendering, decimalPlacesTimings));
-                std::cout << std::format("* Detected as subgroup-uniform...: {}\n", shaderInfoInstancedRendering.IsSubgroupUniform ? "Yes" : "No");
-                std::cout << std::format("* SubgroupCount..................: {}\n", shaderInfoInstancedRendering.SubgroupCount);
-                std::cout << std::format("* SubgroupUtilization............: {}/{}\n", shaderInfoInstancedRendering.SubgroupMaxActiveLanes, shaderInfoInstancedRendering.SubgroupSize);
+                std::array<std::string, 2> cells = { "n/a", "n/a" };
+                for (size_t i = 0; i < passes.size(); i++)
+                {
+                    const Pass& pass = passes[i];
+                    if (pass.DataSource == source && !pass.IsInstrumented && !pass.IsSpecialized && !pass.Upload && !passResults[i].empty())
+                    {
+                        float msPass = ComputeStatistics(passResults[i], &RenderResult::MsElapsed).Median;
+                        cells[pass.UseDrawID] = std::format("{}ms", RoundTo(msPass, decimalPlacesTimings));
+                    }
+                }
+                std::cout << std::format("* {:.<31}: {:>15}{:>15}\n", GetPerDrawDataSourceName(source), cells[0], cells[1]);
             }
             std::cout << '\n';
+
+            std::cout << std::format("Frame time with {} frames in flight: {}\n\n", settings.FramesInFlight, formatTiming(ComputeStatistics(msRecentFrameTimes)));
             {
-                std::cout << std::format("* Rendering with gl_DrawID.......: {}ms\n", RoundTo(msMeshRendering, decimalPlacesTimings));
-                std::cout << std::format("* Detected as subgroup-uniform...: {}\n", shaderInfoMeshRendering.IsSubgroupUniform ? "Yes" : "No");
-                std::cout << std::format("* SubgroupCount..................: {}\n", shaderInfoMeshRendering.SubgroupCount);
-                std::cout << std::format("* SubgroupUtilization............: {}/{}\n", shaderInfoMeshRendering.SubgroupMaxActiveLanes, shaderInfoMeshRendering.SubgroupSize);
+                const GpuTimeline& timeline = lastResolvedTimeline;
+                std::cout << std::format("GPU timeline of frame {}:\n", timeline.FrameIndex);
+
+                for (size_t i = 0; i < timeline.Spans.size(); i++)
+                {
+                    const GpuSpan& span = timeline.Spans[i];
+                    std::cout << std::format("* {:.<40}: {}ms at +{}ms\n",
+                        span.Name,
+                        RoundTo(GetSpanMs(span), decimalPlacesTimings),
+                        RoundTo((span.NsBegin - timeline.Spans[0].NsBegin) / 1000000.0f, decimalPlacesTimings));
+                }
             }
             std::cout << '\n';
             std::cout << '\n';
 
             writeFirstTime = false;
+
+            for (auto& results : passResults)
+            {
+                results.clear();
+            }
+            msRecentFrameTimes.clear();
         }
 
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -281,7 +2506,64 @@ int main()
         }
 
         glfwPollEvents();
+
+        auto swapStart = std::chrono::steady_clock::now();
         glfwSwapBuffers(window);
+        traceCpuSpan("Swap buffers", swapStart);
+
+        if (frameIndex == 1)
+        {
+            // without frames in flight the first sample is in before the first swap, so the profile ends with it
+            if (isFirstSampleMissing && hasResults)
+            {
+                endStartupProfile("First swap");
+            }
+            else
+            {
+                EndStartupPhase(startupProfile, "First swap");
+            }
+        }
+
+        traceCpuSpan(std::format("Frame {}", frameIndex - 1), frameStart);
+
+        float msFrame = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        msFrameTimes.push_back(msFrame);
+        msRecentFrameTimes.push_back(msFrame);
+    }
+
+    collectResolvedFrames(0);
+
+    if (settings.TargetConfidenceIntervalPercent > 0.0f || settings.MaxSeconds > 0.0f)
+    {
+        std::cout << std::format("{} after {} frames and {}s, median GPU time with 95% confidence interval:\n",
+            samplingStopReason, frameIndex, RoundTo(std::chrono::duration<float>(std::chrono::steady_clock::now() - samplingStart).count(), 1));
+        for (size_t i = 0; i < passes.size(); i++)
+        {
+            TimingStatistics statistics = ComputeStatistics(allPassResults[i], &RenderResult::MsElapsed);
+            std::cout << std::format("* {:.<40}: {}ms, {}ms to {}ms ({}% wide), {} samples\n",
+                passes[i].Name,
+                RoundTo(statistics.Median, 3),
+                RoundTo(statistics.MedianLow, 3),
+                RoundTo(statistics.MedianHigh, 3),
+                RoundTo(GetConfidenceIntervalPercent(statistics), 2),
+                statistics.SampleCount);
+        }
+        std::cout << '\n';
+    }
+
+    if (!settings.ResultsPath.empty())
+    {
+        WriteResults(settings, environment, startupProfile, programBuilds, passes, allPassResults, msFrameTimes);
+    }
+
+    if (trace.File.is_open())
+    {
+        EndTrace(trace);
+    }
+
+    if (settings.UseProgramCache)
+    {
+        PruneProgramBinaries();
     }
 
     glfwDestroyWindow(window);